@@ -0,0 +1,305 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalBenchmarkCommandlet.h"
+
+#include "Engine/Engine.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "Misc/App.h"
+#include "Misc/EngineVersion.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonWriter.h"
+#include "Portal/Helpers/PPortalCopyPool.h"
+#include "Portal/Helpers/PPortalHelper.h"
+#include "Portal/Level/PGhostPortalBorder.h"
+#include "Portal/Level/PPortal.h"
+#include "Portal/Level/PPortalWall.h"
+#include "Portal/Subsystems/PPortalSubsystem.h"
+
+DEFINE_LOG_CATEGORY(LogPortalBenchmark);
+
+UPPortalBenchmarkCommandlet::UPPortalBenchmarkCommandlet() : Samples(200), Sink(0.0)
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = false;
+	LogToConsole = true;
+}
+
+int32 UPPortalBenchmarkCommandlet::Main(const FString& Params)
+{
+	FParse::Value(*Params, TEXT("Samples="), Samples);
+	Samples = FMath::Max(Samples, 1);
+
+	FString CubeCountsParam = TEXT("1,16,64");
+	FParse::Value(*Params, TEXT("Cubes="), CubeCountsParam);
+	TArray<FString> CubeCounts;
+	CubeCountsParam.ParseIntoArray(CubeCounts, TEXT(","));
+
+	FString OutputPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FString::Printf(TEXT("PortalBenchmark-%s.json"), *FDateTime::Now().ToString());
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+
+	CubeMesh = LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+	if (CubeMesh == nullptr)
+	{
+		UE_LOG(LogPortalBenchmark, Error, TEXT("Failed to load the engine cube mesh."));
+		return 1;
+	}
+
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, FName("PortalBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+
+	// A 20 by 10 meters wall facing X with two holes, and one portal pair on it
+	APPortalWall* Wall = World->SpawnActorDeferred<APPortalWall>(APPortalWall::StaticClass(), FTransform::Identity);
+	Wall->SetSize(2000.0f, 1000.0f);
+	Wall->SetHoles({ FBox2D(FVector2D(-600.0, -200.0), FVector2D(-400.0, 200.0)), FBox2D(FVector2D(400.0, -200.0), FVector2D(600.0, 200.0)) });
+	Wall->FinishSpawning(FTransform::Identity);
+
+	// The ghost border never begins play, give it the hull of a 120 by 200 centimeters border instead of reading a mesh
+	APGhostPortalBorder* GhostBorder = World->SpawnActor<APGhostPortalBorder>(FVector(1.0, 0.0, 0.0), FRotator::ZeroRotator);
+	GhostBorder->SetHullVertices({ FVector(-100.0, -60.0, 0.0), FVector(100.0, -60.0, 0.0), FVector(100.0, 60.0, 0.0), FVector(-100.0, 60.0, 0.0) });
+
+	UPPortalSubsystem* PortalSubsystem = World->GetSubsystem<UPPortalSubsystem>();
+	APPortal* Portals[2];
+	for (int32 i = 0; i < 2; i++)
+	{
+		const bool bIsLeftPortal = i == 0;
+		const FTransform PortalTransform(FVector(1.0, bIsLeftPortal ? -250.0 : 250.0, 0.0));
+		APPortal* Portal = World->SpawnActorDeferred<APPortal>(APPortal::StaticClass(), PortalTransform, Wall);
+		Portal->Init(bIsLeftPortal);
+		Portal->FinishSpawning(PortalTransform);
+
+		Portal->PlaceOnWall(Wall, FVector2D(60.0, 100.0), false);
+		Portal->RegisterWithPortalSubsystem();
+		Portals[i] = Portal;
+	}
+
+	PortalSubsystem->LinkPortals(Portals[0], Portals[1]);
+
+	BenchmarkConversions(Portals[0]);
+	BenchmarkPlacement(Wall, GhostBorder, Portals[1]);
+
+	for (const FString& CubeCount : CubeCounts)
+		BenchmarkTrackedActors(World, Portals[0], FMath::Max(FCString::Atoi(*CubeCount), 1));
+
+	BenchmarkCopies(World, Portals[0]);
+
+	for (APPortal* Portal : Portals)
+		PortalSubsystem->UnregisterPortal(Portal);
+
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	UE_LOG(LogPortalBenchmark, Verbose, TEXT("Sink %f"), Sink);
+
+	if (WriteResults(OutputPath) == false)
+	{
+		UE_LOG(LogPortalBenchmark, Error, TEXT("Failed to write benchmark results to '%s'."), *OutputPath);
+		return 1;
+	}
+
+	UE_LOG(LogPortalBenchmark, Display, TEXT("Benchmark results written to '%s'."), *OutputPath);
+	return 0;
+}
+
+template <typename FunctionType>
+void UPPortalBenchmarkCommandlet::Measure(const FString& Name, const int32 CallsPerSample, FunctionType&& Function)
+{
+	for (int32 Call = 0; Call < CallsPerSample; Call++)
+		Function();
+
+	TArray<double> SampleTimes;
+	SampleTimes.Reserve(Samples);
+	for (int32 Sample = 0; Sample < Samples; Sample++)
+	{
+		const uint64 StartCycles = FPlatformTime::Cycles64();
+		for (int32 Call = 0; Call < CallsPerSample; Call++)
+			Function();
+
+		SampleTimes.Add(FPlatformTime::ToMilliseconds64(FPlatformTime::Cycles64() - StartCycles) * 1000.0 / CallsPerSample);
+	}
+
+	SampleTimes.Sort();
+
+	double TotalTime = 0.0;
+	for (const double Time : SampleTimes)
+		TotalTime += Time;
+
+	FBenchmarkResult& Result = Results.AddDefaulted_GetRef();
+	Result.Name = Name;
+	Result.CallsPerSample = CallsPerSample;
+	Result.MeanUs = TotalTime / SampleTimes.Num();
+	Result.MedianUs = SampleTimes[SampleTimes.Num() / 2];
+	Result.P95Us = SampleTimes[FMath::Min(FMath::FloorToInt32(SampleTimes.Num() * 0.95), SampleTimes.Num() - 1)];
+	Result.MinUs = SampleTimes[0];
+	Result.MaxUs = SampleTimes.Last();
+
+	UE_LOG(LogPortalBenchmark, Display, TEXT("%-48s mean %10.3f us, median %10.3f us, p95 %10.3f us"), *Name, Result.MeanUs, Result.MedianUs, Result.P95Us);
+}
+
+void UPPortalBenchmarkCommandlet::BenchmarkConversions(APPortal* Portal)
+{
+	APPortal* TargetPortal = Portal->GetLinkedPortal();
+	const FVector Location(50.0, -230.0, 40.0);
+	const FVector Direction = FVector(-1.0, 0.2, 0.1).GetSafeNormal();
+	const FRotator Rotation(10.0, 170.0, 0.0);
+
+	Measure(TEXT("PPortalHelper.ConvertLocationToPortalSpace"), 1000, [&]()
+	{
+		Sink += UPPortalHelper::ConvertLocationToPortalSpace(Location, Portal, TargetPortal).X;
+	});
+
+	Measure(TEXT("PPortalHelper.ConvertDirectionToPortalSpace"), 1000, [&]()
+	{
+		Sink += UPPortalHelper::ConvertDirectionToPortalSpace(Direction, Portal, TargetPortal).X;
+	});
+
+	Measure(TEXT("PPortalHelper.ConvertRotationToPortalSpace"), 1000, [&]()
+	{
+		Sink += UPPortalHelper::ConvertRotationToPortalSpace(Rotation, Portal, TargetPortal).Yaw;
+	});
+
+	// Batch of 64 transforms, converted back and forth so the values stay the same from one call to the next
+	TArray<FVector> Locations;
+	TArray<FQuat> Rotations;
+	Locations.Init(Location, 64);
+	Rotations.Init(Rotation.Quaternion(), 64);
+	Measure(TEXT("PPortalHelper.ConvertTransformsToPortalSpace64"), 100, [&]()
+	{
+		UPPortalHelper::ConvertTransformsToPortalSpace(Locations, Rotations, Portal, TargetPortal);
+		UPPortalHelper::ConvertTransformsToPortalSpace(Locations, Rotations, TargetPortal, Portal);
+		Sink += Locations[0].X;
+	});
+}
+
+void UPPortalBenchmarkCommandlet::BenchmarkPlacement(APPortalWall* Wall, APGhostPortalBorder* GhostBorder, APPortal* OtherSidePortal)
+{
+	FVector PortalLocation;
+	FVector2D PortalExtents;
+
+	// Nothing in the way, the portal stays where it was shot
+	Measure(TEXT("PPortalWall.TryGetPortalPos.Free"), 100, [&]()
+	{
+		Sink += Wall->TryGetPortalPos(FVector(1.0, 800.0, 0.0), GhostBorder, true, PortalLocation, PortalExtents);
+	});
+
+	// Shot right on the other portal, the placement has to search for the nearest free spot
+	Measure(TEXT("PPortalWall.TryGetPortalPos.Blocked"), 100, [&]()
+	{
+		Sink += Wall->TryGetPortalPos(OtherSidePortal->GetActorLocation(), GhostBorder, true, PortalLocation, PortalExtents);
+	});
+
+	// The check the gun runs against its other portal
+	Measure(TEXT("PPortalHelper.IsPortalPlacementClear"), 1000, [&]()
+	{
+		Sink += UPPortalHelper::IsPortalPlacementClear(OtherSidePortal, Wall, PortalLocation, PortalExtents);
+	});
+}
+
+void UPPortalBenchmarkCommandlet::BenchmarkTrackedActors(UWorld* World, APPortal* Portal, const int32 NumCubes)
+{
+	// Cubes standing still in front of the portal, tracked but never crossing it
+	TArray<AActor*> Cubes;
+	for (int32 i = 0; i < NumCubes; i++)
+	{
+		const FVector PortalLocation = Portal->GetActorLocation();
+		const FVector Offset(30.0 + (i / 16) * 25.0, (i % 4) * 25.0 - 37.5, ((i / 4) % 4) * 25.0 - 37.5);
+		AActor* Cube = SpawnCube(World, PortalLocation + Offset);
+		Portal->AddTrackedActor(Cube);
+		Cubes.Add(Cube);
+	}
+
+	Measure(FString::Printf(TEXT("PPortal.UpdateTrackedActors.%d"), NumCubes), 1, [&]()
+	{
+		Portal->UpdateTrackedActors(1.0f / 60.0f);
+	});
+
+	for (AActor* Cube : Cubes)
+	{
+		Portal->RemoveTrackedActor(Cube);
+		Cube->Destroy();
+	}
+}
+
+void UPPortalBenchmarkCommandlet::BenchmarkCopies(UWorld* World, APPortal* Portal)
+{
+	AActor* Cube = SpawnCube(World, Portal->GetActorLocation() + FVector(30.0, 0.0, 0.0));
+
+	// What a portal pays when an actor enters and leaves its box, with instanced copies then with pooled actor copies
+	const bool bUseInstancedCopies = Portal->UsesInstancedCopies();
+	for (const bool bInstanced : { true, false })
+	{
+		Portal->SetUseInstancedCopies(bInstanced);
+		Measure(bInstanced ? TEXT("PPortal.TrackAndCopy.Instanced") : TEXT("PPortal.TrackAndCopy.Pooled"), 10, [&]()
+		{
+			Portal->AddTrackedActor(Cube);
+			Portal->RemoveTrackedActor(Cube);
+		});
+	}
+
+	Portal->SetUseInstancedCopies(bUseInstancedCopies);
+
+	// Creating and destroying an actor copy, the cost the pool saves
+	FPortalCopyPool CopyPool;
+	Measure(TEXT("PortalCopyPool.CreateDestroy"), 10, [&]()
+	{
+		if (AActor* Copy = CopyPool.Acquire(Cube))
+			Copy->Destroy();
+	});
+
+	CopyPool.Prewarm(Cube, 1);
+	Measure(TEXT("PortalCopyPool.AcquireRelease"), 10, [&]()
+	{
+		CopyPool.Release(CopyPool.Acquire(Cube));
+	});
+
+	CopyPool.Reset();
+	Cube->Destroy();
+}
+
+AActor* UPPortalBenchmarkCommandlet::SpawnCube(UWorld* World, const FVector& Location) const
+{
+	AStaticMeshActor* Cube = World->SpawnActor<AStaticMeshActor>(Location, FRotator::ZeroRotator);
+	Cube->SetMobility(EComponentMobility::Movable);
+	Cube->GetStaticMeshComponent()->SetStaticMesh(CubeMesh);
+	Cube->SetActorScale3D(FVector(0.2));
+
+	return Cube;
+}
+
+bool UPPortalBenchmarkCommandlet::WriteResults(const FString& Path) const
+{
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("Engine"), FEngineVersion::Current().ToString());
+	Writer->WriteValue(TEXT("Configuration"), FString(LexToString(FApp::GetBuildConfiguration())));
+	Writer->WriteValue(TEXT("Platform"), FString(FPlatformProperties::IniPlatformName()));
+	Writer->WriteValue(TEXT("Timestamp"), FDateTime::UtcNow().ToIso8601());
+	Writer->WriteValue(TEXT("Samples"), Samples);
+
+	Writer->WriteArrayStart(TEXT("Results"));
+	for (const FBenchmarkResult& Result : Results)
+	{
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("Name"), Result.Name);
+		Writer->WriteValue(TEXT("CallsPerSample"), Result.CallsPerSample);
+		Writer->WriteValue(TEXT("MeanUs"), Result.MeanUs);
+		Writer->WriteValue(TEXT("MedianUs"), Result.MedianUs);
+		Writer->WriteValue(TEXT("P95Us"), Result.P95Us);
+		Writer->WriteValue(TEXT("MinUs"), Result.MinUs);
+		Writer->WriteValue(TEXT("MaxUs"), Result.MaxUs);
+		Writer->WriteObjectEnd();
+	}
+	Writer->WriteArrayEnd();
+
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	return FFileHelper::SaveStringToFile(Json, *Path);
+}
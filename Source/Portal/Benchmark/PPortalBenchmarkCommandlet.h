@@ -0,0 +1,67 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PPortalBenchmarkCommandlet.generated.h"
+
+class APGhostPortalBorder;
+class APPortal;
+class APPortalWall;
+
+/* Logging category for the portal benchmark. */
+DECLARE_LOG_CATEGORY_EXTERN(LogPortalBenchmark, Log, All);
+
+/*
+ Game thread benchmark of the portal code, runnable on build machines without a GPU:
+ UnrealEditor-Cmd Portal.uproject -run=PPortalBenchmark -nullrhi -unattended [-Samples=200] [-Cubes=1,16,64] [-Output=Path.json]
+ Everything is spawned in a transient world that never begins play, so no map, player or render thread work is involved.
+ Results are per call timings in microseconds, written as JSON to Saved/Benchmarks unless an output path is given.
+ */
+UCLASS()
+class PORTAL_API UPPortalBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UPPortalBenchmarkCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+private:
+	/* Per call timings of one benchmark, over every sample. */
+	struct FBenchmarkResult
+	{
+		FString Name;
+		int32 CallsPerSample = 0;
+		double MeanUs = 0.0;
+		double MedianUs = 0.0;
+		double P95Us = 0.0;
+		double MinUs = 0.0;
+		double MaxUs = 0.0;
+	};
+
+	/* Time Samples batches of CallsPerSample calls, after one untimed batch to warm up caches. */
+	template <typename FunctionType>
+	void Measure(const FString& Name, int32 CallsPerSample, FunctionType&& Function);
+
+	void BenchmarkConversions(APPortal* Portal);
+	void BenchmarkPlacement(APPortalWall* Wall, APGhostPortalBorder* GhostBorder, APPortal* OtherSidePortal);
+	void BenchmarkTrackedActors(UWorld* World, APPortal* Portal, int32 NumCubes);
+	void BenchmarkCopies(UWorld* World, APPortal* Portal);
+
+	AActor* SpawnCube(UWorld* World, const FVector& Location) const;
+
+	bool WriteResults(const FString& Path) const;
+
+	TArray<FBenchmarkResult> Results;
+
+	UPROPERTY()
+	TObjectPtr<UStaticMesh> CubeMesh;
+
+	int32 Samples;
+
+	/* Accumulates the results of pure functions so the compiler can't drop the calls. */
+	double Sink;
+};
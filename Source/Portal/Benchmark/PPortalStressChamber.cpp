@@ -0,0 +1,365 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalStressChamber.h"
+
+#include "EngineUtils.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+#include "Kismet/GameplayStatics.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/JsonWriter.h"
+#include "Portal/PCharacter.h"
+#include "Portal/PGunComponent.h"
+#include "Portal/Level/PDoor.h"
+#include "Portal/Level/PDoorTrigger.h"
+#include "Portal/Level/PPortal.h"
+#include "Portal/Level/PPortalWall.h"
+#include "Portal/Subsystems/PPortalSubsystem.h"
+
+APPortalStressChamber::APPortalStressChamber() : Random(42), StartTime(0.0), LastFrameTime(0.0), LastLaunchTime(0.0), StartCaptures(0), StartTeleports(0),
+                                                 TrackedActorFrames(0), MaxTrackedActors(0), bIsRunning(false)
+{
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+}
+
+void APPortalStressChamber::Run(const FPortalStressChamberSettings& InSettings)
+{
+	Settings = InSettings;
+	Settings.NumWalls = FMath::Max(Settings.NumWalls, 1);
+	Settings.NumPortalPairs = FMath::Clamp(Settings.NumPortalPairs, 0, Settings.NumWalls);
+
+	// Around the player so the portals are seen and captured, the ring is wide enough for every wall
+	const APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+	const FVector Center = PlayerPawn ? PlayerPawn->GetActorLocation() : GetActorLocation();
+	const double Radius = FMath::Max(1000.0, Settings.NumWalls * WallWidth * 1.2 / UE_DOUBLE_TWO_PI);
+
+	SpawnWalls(Center, Radius);
+	SpawnPortals();
+	SpawnCubes(Center, Radius);
+	SpawnDoorChains(Center, Radius);
+	LaunchCubes();
+
+	if (const UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>())
+	{
+		StartCaptures = PortalSubsystem->GetNumCaptures();
+		StartTeleports = PortalSubsystem->GetNumTeleports();
+	}
+
+	UE_LOG(LogPortal, Display, TEXT("Portal stress chamber: %d walls, %d portal pairs, %d cubes, %d door chains for %.1f seconds"),
+	       Walls.Num(), Portals.Num() / 2, Cubes.Num(), Settings.NumDoorChains, Settings.Duration);
+
+	StartTime = FPlatformTime::Seconds();
+	LastFrameTime = StartTime;
+	LastLaunchTime = StartTime;
+	bIsRunning = true;
+	SetActorTickEnabled(true);
+}
+
+void APPortalStressChamber::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (bIsRunning == false)
+		return;
+
+	const double Now = FPlatformTime::Seconds();
+	FrameTimesMs.Add(static_cast<float>((Now - LastFrameTime) * 1000.0));
+	LastFrameTime = Now;
+
+	int32 TrackedActors = 0;
+	for (const APPortal* Portal : Portals)
+	{
+		if (IsValid(Portal))
+			TrackedActors += Portal->GetTrackedActors().Num();
+	}
+
+	TrackedActorFrames += TrackedActors;
+	MaxTrackedActors = FMath::Max(MaxTrackedActors, TrackedActors);
+
+	if (Now - LastLaunchTime >= LaunchInterval)
+	{
+		LaunchCubes();
+		LastLaunchTime = Now;
+	}
+
+	if (Now - StartTime >= Settings.Duration)
+		Finish();
+}
+
+void APPortalStressChamber::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (const TArray<TObjectPtr<AActor>>* Actors : { &Cubes, &DoorChainActors })
+	{
+		for (AActor* Actor : *Actors)
+		{
+			if (IsValid(Actor))
+				Actor->Destroy();
+		}
+	}
+
+	for (APPortal* Portal : Portals)
+	{
+		if (IsValid(Portal))
+			Portal->Destroy();
+	}
+
+	for (APPortalWall* Wall : Walls)
+	{
+		if (IsValid(Wall))
+			Wall->Destroy();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void APPortalStressChamber::SpawnWalls(const FVector& Center, const double Radius)
+{
+	const TSubclassOf<APPortalWall> WallClass = FindLevelClass<APPortalWall>(APPortalWall::StaticClass(), [](const APPortalWall*) { return true; });
+
+	// A ring of walls facing its center
+	for (int32 i = 0; i < Settings.NumWalls; i++)
+	{
+		const double Angle = UE_DOUBLE_TWO_PI * i / Settings.NumWalls;
+		const FVector Location = Center + FVector(FMath::Cos(Angle), FMath::Sin(Angle), 0.0) * Radius;
+		const FTransform WallTransform((Center - Location).Rotation(), Location);
+
+		APPortalWall* Wall = GetWorld()->SpawnActorDeferred<APPortalWall>(WallClass, WallTransform, this, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		Wall->SetSize(WallWidth, WallHeight);
+		Wall->FinishSpawning(WallTransform);
+		Walls.Add(Wall);
+	}
+}
+
+void APPortalStressChamber::SpawnPortals()
+{
+	UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>();
+	if (PortalSubsystem == nullptr)
+		return;
+
+	// Designer placed portals first, the player's gun portals otherwise
+	TSubclassOf<APPortal> PortalClass = FindLevelClass<APPortal>(nullptr, [](const APPortal*) { return true; });
+	if (PortalClass == nullptr)
+	{
+		const APawn* PlayerPawn = UGameplayStatics::GetPlayerPawn(this, 0);
+		const UPGunComponent* Gun = PlayerPawn ? PlayerPawn->FindComponentByClass<UPGunComponent>() : nullptr;
+		PortalClass = Gun && Gun->GetPortalClass() ? Gun->GetPortalClass() : APPortal::StaticClass();
+	}
+
+	// Portal N goes on wall N modulo the wall count, the left half of the walls first, then the right half
+	for (int32 i = 0; i < Settings.NumPortalPairs * 2; i++)
+	{
+		APPortalWall* Wall = Walls[i % Walls.Num()];
+		const bool bIsLeftPortal = i % 2 == 0;
+		const double SlotOffset = (i / Walls.Num() == 0 ? -0.25 : 0.25) * WallWidth;
+		const FTransform PortalTransform(Wall->GetActorRotation(), Wall->GetTransform().TransformPosition(FVector(1.0, SlotOffset, 0.0)));
+
+		APPortal* Portal = GetWorld()->SpawnActorDeferred<APPortal>(PortalClass, PortalTransform, Wall, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		Portal->Init(bIsLeftPortal);
+		Portal->FinishSpawning(PortalTransform);
+
+		Portal->PlaceOnWall(Wall, FVector2D(WallWidth * 0.2, WallHeight * 0.4), false);
+		Portals.Add(Portal);
+
+		if (bIsLeftPortal == false)
+			PortalSubsystem->LinkPortals(Portals[i - 1], Portal);
+	}
+}
+
+void APPortalStressChamber::SpawnCubes(const FVector& Center, const double Radius)
+{
+	const TSubclassOf<AActor> CubeClass = FindLevelClass<AActor>(nullptr, [](const AActor* Actor)
+	{
+		const USceneComponent* Root = Actor->GetRootComponent();
+		return Root && Root->IsSimulatingPhysics() && Actor->IsA<APCharacter>() == false;
+	});
+
+	UStaticMesh* CubeMesh = CubeClass ? nullptr : LoadObject<UStaticMesh>(nullptr, TEXT("/Engine/BasicShapes/Cube.Cube"));
+
+	for (int32 i = 0; i < Settings.NumCubes; i++)
+	{
+		const FVector Offset = Random.GetUnitVector().GetSafeNormal2D() * Random.FRandRange(0.0, Radius * 0.5);
+		const FVector Location = Center + Offset + FVector(0.0, 0.0, Random.FRandRange(200.0, 600.0));
+
+		AActor* Cube;
+		if (CubeClass)
+		{
+			Cube = GetWorld()->SpawnActor<AActor>(CubeClass, FTransform(Location), FActorSpawnParameters());
+		}
+		else
+		{
+			// No cube in the level, a small engine cube set up like the companion cubes
+			AStaticMeshActor* MeshActor = GetWorld()->SpawnActor<AStaticMeshActor>(Location, FRotator::ZeroRotator);
+			MeshActor->SetMobility(EComponentMobility::Movable);
+			MeshActor->SetActorScale3D(FVector(0.5));
+			MeshActor->GetStaticMeshComponent()->SetStaticMesh(CubeMesh);
+			MeshActor->GetStaticMeshComponent()->SetCollisionProfileName(FName("ComapnionCube"));
+			MeshActor->GetStaticMeshComponent()->SetSimulatePhysics(true);
+			MeshActor->GetStaticMeshComponent()->SetGenerateOverlapEvents(true);
+			Cube = MeshActor;
+		}
+
+		if (Cube != nullptr)
+			Cubes.Add(Cube);
+	}
+}
+
+void APPortalStressChamber::SpawnDoorChains(const FVector& Center, const double Radius)
+{
+	const TSubclassOf<APDoorTrigger> TriggerClass = FindLevelClass<APDoorTrigger>(APDoorTrigger::StaticClass(), [](const APDoorTrigger*) { return true; });
+	const TSubclassOf<APDoor> DoorClass = FindLevelClass<APDoor>(APDoor::StaticClass(), [](const APDoor*) { return true; });
+
+	// Triggers inside the ring where the cubes land, each door waits for its trigger and all the triggers before it
+	TArray<AActor*> Triggers;
+	for (int32 i = 0; i < Settings.NumDoorChains; i++)
+	{
+		const double Angle = UE_DOUBLE_TWO_PI * (i + 0.5) / FMath::Max(Settings.NumDoorChains, 1);
+		const FVector Direction(FMath::Cos(Angle), FMath::Sin(Angle), 0.0);
+
+		APDoorTrigger* Trigger = GetWorld()->SpawnActor<APDoorTrigger>(TriggerClass, FTransform(Center + Direction * Radius * 0.3));
+		if (Trigger == nullptr)
+			continue;
+
+		Triggers.Add(Trigger);
+		DoorChainActors.Add(Trigger);
+
+		const FTransform DoorTransform(Direction.Rotation(), Center + Direction * Radius * 0.6);
+		APDoor* Door = GetWorld()->SpawnActorDeferred<APDoor>(DoorClass, DoorTransform, this, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		Door->SetTriggers(Triggers);
+		Door->FinishSpawning(DoorTransform);
+		DoorChainActors.Add(Door);
+	}
+}
+
+void APPortalStressChamber::LaunchCubes()
+{
+	if (Portals.Num() == 0)
+		return;
+
+	for (AActor* Cube : Cubes)
+	{
+		UPrimitiveComponent* Root = IsValid(Cube) ? Cast<UPrimitiveComponent>(Cube->GetRootComponent()) : nullptr;
+		if (Root == nullptr || Root->IsSimulatingPhysics() == false)
+			continue;
+
+		const APPortal* Target = Portals[Random.RandHelper(Portals.Num())];
+		const FVector Direction = (Target->GetActorLocation() - Cube->GetActorLocation()).GetSafeNormal();
+		Root->SetPhysicsLinearVelocity(Direction * LaunchSpeed);
+	}
+}
+
+void APPortalStressChamber::Finish()
+{
+	bIsRunning = false;
+	SetActorTickEnabled(false);
+
+	TArray<float> SortedFrameTimesMs = FrameTimesMs;
+	SortedFrameTimesMs.Sort();
+
+	auto Percentile = [&SortedFrameTimesMs](const double Fraction)
+	{
+		return SortedFrameTimesMs.Num() > 0 ? SortedFrameTimesMs[FMath::Min(FMath::FloorToInt32(SortedFrameTimesMs.Num() * Fraction), SortedFrameTimesMs.Num() - 1)] : 0.0f;
+	};
+
+	UE_LOG(LogPortal, Display, TEXT("Portal stress chamber: %d frames, p50 %.2f ms, p90 %.2f ms, p99 %.2f ms, max %.2f ms"),
+	       SortedFrameTimesMs.Num(), Percentile(0.5), Percentile(0.9), Percentile(0.99), Percentile(1.0));
+
+	const FString ReportPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FString::Printf(TEXT("PortalStressChamber-%s.json"), *FDateTime::Now().ToString());
+	if (SaveReport(ReportPath, SortedFrameTimesMs))
+		UE_LOG(LogPortal, Display, TEXT("Portal stress chamber report written to '%s'."), *ReportPath);
+	else
+		UE_LOG(LogPortal, Error, TEXT("Failed to write the portal stress chamber report to '%s'."), *ReportPath);
+
+	Destroy();
+}
+
+bool APPortalStressChamber::SaveReport(const FString& Path, const TArray<float>& SortedFrameTimesMs) const
+{
+	const UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>();
+	const uint32 Captures = PortalSubsystem ? PortalSubsystem->GetNumCaptures() - StartCaptures : 0;
+	const uint32 Teleports = PortalSubsystem ? PortalSubsystem->GetNumTeleports() - StartTeleports : 0;
+	const int32 NumFrames = FMath::Max(SortedFrameTimesMs.Num(), 1);
+
+	FString Json;
+	const TSharedRef<TJsonWriter<>> Writer = TJsonWriterFactory<>::Create(&Json);
+
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("Map"), UWorld::RemovePIEPrefix(GetWorld()->GetMapName()));
+	Writer->WriteValue(TEXT("Walls"), Walls.Num());
+	Writer->WriteValue(TEXT("PortalPairs"), Portals.Num() / 2);
+	Writer->WriteValue(TEXT("Cubes"), Cubes.Num());
+	Writer->WriteValue(TEXT("DoorChains"), Settings.NumDoorChains);
+	Writer->WriteValue(TEXT("Duration"), Settings.Duration);
+	Writer->WriteValue(TEXT("Frames"), SortedFrameTimesMs.Num());
+
+	Writer->WriteObjectStart(TEXT("FrameTimeMs"));
+	for (const TPair<const TCHAR*, double>& Percentile : { TPair<const TCHAR*, double>(TEXT("P50"), 0.5), TPair<const TCHAR*, double>(TEXT("P90"), 0.9),
+	                                                        TPair<const TCHAR*, double>(TEXT("P95"), 0.95), TPair<const TCHAR*, double>(TEXT("P99"), 0.99),
+	                                                        TPair<const TCHAR*, double>(TEXT("Max"), 1.0) })
+	{
+		const int32 Index = FMath::Min(FMath::FloorToInt32(SortedFrameTimesMs.Num() * Percentile.Value), SortedFrameTimesMs.Num() - 1);
+		Writer->WriteValue(Percentile.Key, SortedFrameTimesMs.IsValidIndex(Index) ? SortedFrameTimesMs[Index] : 0.0f);
+	}
+	Writer->WriteObjectEnd();
+
+	Writer->WriteObjectStart(TEXT("Portal"));
+	Writer->WriteValue(TEXT("CapturesPerFrame"), static_cast<double>(Captures) / NumFrames);
+	Writer->WriteValue(TEXT("Teleports"), static_cast<int64>(Teleports));
+	Writer->WriteValue(TEXT("AverageTrackedActors"), static_cast<double>(TrackedActorFrames) / NumFrames);
+	Writer->WriteValue(TEXT("MaxTrackedActors"), MaxTrackedActors);
+	Writer->WriteObjectEnd();
+
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	return FFileHelper::SaveStringToFile(Json, *Path);
+}
+
+template <typename ActorType>
+TSubclassOf<ActorType> APPortalStressChamber::FindLevelClass(TSubclassOf<ActorType> FallbackClass, TFunctionRef<bool(const ActorType*)> Filter) const
+{
+	for (TActorIterator<ActorType> It(GetWorld()); It; ++It)
+	{
+		const ActorType* Actor = *It;
+		if (Actor->GetOwner() != this && Filter(Actor))
+			return Actor->GetClass();
+	}
+
+	return FallbackClass;
+}
+
+#if !UE_BUILD_SHIPPING
+
+/* Arguments: walls, cubes, portal pairs, door chains and seconds, all optional. */
+static void RunPortalStressChamber(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr || World->IsGameWorld() == false)
+		return;
+
+	FPortalStressChamberSettings Settings;
+	int32* const IntArgs[] = { &Settings.NumWalls, &Settings.NumCubes, &Settings.NumPortalPairs, &Settings.NumDoorChains };
+	for (int32 i = 0; i < UE_ARRAY_COUNT(IntArgs) && i < Args.Num(); i++)
+		*IntArgs[i] = FMath::Max(0, FCString::Atoi(*Args[i]));
+
+	if (Args.Num() > UE_ARRAY_COUNT(IntArgs))
+		Settings.Duration = FMath::Max(1.0f, FCString::Atof(*Args[UE_ARRAY_COUNT(IntArgs)]));
+
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.ObjectFlags |= RF_Transient;
+	if (APPortalStressChamber* Chamber = World->SpawnActor<APPortalStressChamber>(SpawnParams))
+		Chamber->Run(Settings);
+}
+
+static FAutoConsoleCommandWithWorldAndArgs PortalStressChamberCommand(
+	TEXT("sm.PortalStressChamber"),
+	TEXT("Spawn a portal stress chamber around the player and report frame time percentiles and portal counters. Optional arguments: walls, cubes, portal pairs, door chains, seconds"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunPortalStressChamber),
+	ECVF_Cheat);
+
+#endif
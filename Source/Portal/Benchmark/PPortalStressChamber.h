@@ -0,0 +1,101 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PPortalStressChamber.generated.h"
+
+class APDoor;
+class APDoorTrigger;
+class APPortal;
+class APPortalWall;
+
+/* Size and length of a stress chamber run. */
+struct FPortalStressChamberSettings
+{
+	int32 NumWalls = 16;
+	int32 NumCubes = 100;
+
+	/* Linked portal pairs placed on the walls, two portals per wall at most. */
+	int32 NumPortalPairs = 8;
+
+	/* Each door of a chain opens once its trigger and every trigger before it are activated. */
+	int32 NumDoorChains = 4;
+
+	float Duration = 30.0f;
+};
+
+/*
+ Scaling benchmark of the tracking, copy and capture paths: a ring of portal walls around the player, linked portal pairs on them,
+ physics cubes relaunched at the portals every few seconds and trigger and door chains. Started with the sm.PortalStressChamber
+ console command, also from a headless process with -ExecCmds. Every actor uses the class of the same kind of actor already in the
+ level, so the chamber looks and collides like the level. At the end the frame time percentiles and portal counters are logged and
+ written to Saved/Benchmarks, then the chamber is removed.
+ */
+UCLASS(NotPlaceable, Transient)
+class PORTAL_API APPortalStressChamber : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	APPortalStressChamber();
+
+	virtual void Tick(float DeltaTime) override;
+
+	/* Spawn the chamber around the player and start measuring. */
+	void Run(const FPortalStressChamberSettings& InSettings);
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	void SpawnWalls(const FVector& Center, double Radius);
+	void SpawnPortals();
+	void SpawnCubes(const FVector& Center, double Radius);
+	void SpawnDoorChains(const FVector& Center, double Radius);
+
+	/* Throw every cube at a random portal. */
+	void LaunchCubes();
+
+	void Finish();
+	bool SaveReport(const FString& Path, const TArray<float>& SortedFrameTimesMs) const;
+
+	/* Class of the first actor of the level matching the filter, the fallback class if there is none. */
+	template <typename ActorType>
+	TSubclassOf<ActorType> FindLevelClass(TSubclassOf<ActorType> FallbackClass, TFunctionRef<bool(const ActorType*)> Filter) const;
+
+	/* Width and height of the spawned walls, each one holds two portals side by side. */
+	static constexpr float WallWidth = 600.0f;
+	static constexpr float WallHeight = 400.0f;
+
+	/* Seconds between two cube launches. */
+	static constexpr double LaunchInterval = 3.0;
+
+	static constexpr float LaunchSpeed = 1500.0f;
+
+	FPortalStressChamberSettings Settings;
+	FRandomStream Random;
+
+	UPROPERTY()
+	TArray<TObjectPtr<APPortalWall>> Walls;
+
+	UPROPERTY()
+	TArray<TObjectPtr<APPortal>> Portals;
+
+	UPROPERTY()
+	TArray<TObjectPtr<AActor>> Cubes;
+
+	UPROPERTY()
+	TArray<TObjectPtr<AActor>> DoorChainActors;
+
+	TArray<float> FrameTimesMs;
+	double StartTime;
+	double LastFrameTime;
+	double LastLaunchTime;
+	uint32 StartCaptures;
+	uint32 StartTeleports;
+	int64 TrackedActorFrames;
+	int32 MaxTrackedActors;
+	bool bIsRunning;
+};
@@ -0,0 +1,144 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalCopyPool.h"
+
+#include "PPortalHelper.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/World.h"
+
+void FPortalCopyPool::Prewarm(AActor* Source, const int32 Count)
+{
+	if (IsValid(Source) == false)
+		return;
+
+	FPooledPortalCopies& Pool = Pools.FindOrAdd(Source->GetClass());
+	while (Pool.FreeCopies.Num() < Count)
+	{
+		AActor* Copy = CreateCopy(Source);
+		if (Copy == nullptr)
+			return;
+
+		Release(Copy);
+	}
+}
+
+AActor* FPortalCopyPool::Acquire(AActor* Source)
+{
+	if (IsValid(Source) == false)
+		return nullptr;
+
+	AActor* Copy = nullptr;
+	FPooledPortalCopies& Pool = Pools.FindOrAdd(Source->GetClass());
+	while (Copy == nullptr && Pool.FreeCopies.Num() > 0)
+	{
+		Copy = Pool.FreeCopies.Pop(EAllowShrinking::No);
+		if (IsValid(Copy) == false)
+			Copy = nullptr;
+	}
+
+	// Pool ran dry, grow it
+	if (Copy == nullptr)
+		Copy = CreateCopy(Source);
+
+	if (Copy == nullptr)
+		return nullptr;
+
+	SyncCopy(Copy, Source);
+	Copy->SetActorEnableCollision(true);
+	Copy->SetActorHiddenInGame(false);
+
+	return Copy;
+}
+
+void FPortalCopyPool::Release(AActor* Copy)
+{
+	if (IsValid(Copy) == false)
+		return;
+
+	Copy->SetActorHiddenInGame(true);
+	Copy->SetActorEnableCollision(false);
+
+	// The class of a copy is the one of the actor it was created from, see CreateCopy
+	Pools.FindOrAdd(Copy->GetClass()).FreeCopies.Add(Copy);
+}
+
+void FPortalCopyPool::Reset()
+{
+	for (TPair<TObjectPtr<UClass>, FPooledPortalCopies>& Pool : Pools)
+	{
+		for (AActor* Copy : Pool.Value.FreeCopies)
+		{
+			if (IsValid(Copy))
+				Copy->UnregisterAllComponents();
+		}
+	}
+
+	Pools.Reset();
+}
+
+int32 FPortalCopyPool::NumFree() const
+{
+	int32 Count = 0;
+	for (const TPair<TObjectPtr<UClass>, FPooledPortalCopies>& Pool : Pools)
+		Count += Pool.Value.FreeCopies.Num();
+
+	return Count;
+}
+
+AActor* FPortalCopyPool::CreateCopy(AActor* Source)
+{
+	UWorld* World = Source->GetWorld();
+	if (World == nullptr)
+		return nullptr;
+
+	// Clone the source with its components, the copy is never spawned so it doesn't tick or begin play
+	ULevel* Outer = World->PersistentLevel;
+	const FName CopyName = MakeUniqueObjectName(Outer, Source->GetClass(), "CopiedActor");
+	AActor* Copy = NewObject<AActor>(Outer, Source->GetClass(), CopyName, RF_Transient, Source);
+	ensureMsgf(Copy, TEXT("Failed to create a portal copy of %s."), *Source->GetName());
+	if (Copy == nullptr)
+		return nullptr;
+
+	Copy->RegisterAllComponents();
+
+	TArray<UStaticMeshComponent*> StaticMeshes;
+	Copy->GetComponents(StaticMeshes);
+	for (UStaticMeshComponent* StaticMeshComp : StaticMeshes)
+	{
+		StaticMeshComp->SetCollisionObjectType(ECC_WorldDynamic);
+		StaticMeshComp->SetCollisionResponseToChannel(ECC_PortalBox, ECR_Ignore);
+		StaticMeshComp->SetCollisionResponseToChannel(ECC_PortalWall, ECR_Ignore);
+		StaticMeshComp->SetCollisionResponseToChannel(ECC_Portal, ECR_Ignore);
+		StaticMeshComp->SetCollisionResponseToChannel(ECC_CompanionCube, ECR_Ignore);
+		StaticMeshComp->SetCollisionResponseToChannel(ECC_Pawn, ECR_Ignore);
+		StaticMeshComp->SetSimulatePhysics(false);
+	}
+
+	return Copy;
+}
+
+void FPortalCopyPool::SyncCopy(AActor* Copy, const AActor* Source)
+{
+	Copy->SetActorScale3D(Source->GetActorScale3D());
+
+	// Copies are shared by every instance of a class, only touch the meshes and materials that differ
+	TArray<UStaticMeshComponent*> SourceMeshes;
+	TArray<UStaticMeshComponent*> CopyMeshes;
+	Source->GetComponents(SourceMeshes);
+	Copy->GetComponents(CopyMeshes);
+
+	const int32 Count = FMath::Min(SourceMeshes.Num(), CopyMeshes.Num());
+	for (int32 i = 0; i < Count; i++)
+	{
+		if (CopyMeshes[i]->GetStaticMesh() != SourceMeshes[i]->GetStaticMesh())
+			CopyMeshes[i]->SetStaticMesh(SourceMeshes[i]->GetStaticMesh());
+
+		for (int32 Slot = 0; Slot < SourceMeshes[i]->GetNumMaterials(); Slot++)
+		{
+			UMaterialInterface* Material = SourceMeshes[i]->GetMaterial(Slot);
+			if (CopyMeshes[i]->GetMaterial(Slot) != Material)
+				CopyMeshes[i]->SetMaterial(Slot, Material);
+		}
+	}
+}
@@ -0,0 +1,47 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PPortalCopyPool.generated.h"
+
+/* Free copies of one actor class. */
+USTRUCT()
+struct FPooledPortalCopies
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<TObjectPtr<AActor>> FreeCopies;
+};
+
+/*
+ Pool of the render and shadow only copies portals show of the actors going through them, one list per actor class.
+ Copies are created once from a live instance and lent out, returning one just hides it and turns its collision off.
+ */
+USTRUCT()
+struct FPortalCopyPool
+{
+	GENERATED_BODY()
+
+	/* Create copies of the source actor until its class has Count free ones. */
+	void Prewarm(AActor* Source, int32 Count);
+
+	/* Borrow a copy of the source actor, matching its meshes and scale, visible and with collision enabled. */
+	AActor* Acquire(AActor* Source);
+
+	/* Give a copy back to the pool, hidden and without collision. */
+	void Release(AActor* Copy);
+
+	/* Drop every free copy. */
+	void Reset();
+
+	int32 NumFree() const;
+
+private:
+	static AActor* CreateCopy(AActor* Source);
+	static void SyncCopy(AActor* Copy, const AActor* Source);
+
+	UPROPERTY()
+	TMap<TObjectPtr<UClass>, FPooledPortalCopies> Pools;
+};
@@ -0,0 +1,135 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalCrossingTracker.h"
+
+int32 FPortalCrossingTracker::Add(AActor* Actor, USceneComponent* TrackedComp, const FVector& Location, const bool bFrontToBackOnly)
+{
+	LastX.Add(Location.X);
+	LastY.Add(Location.Y);
+	LastZ.Add(Location.Z);
+
+	CurrentX.Add(Location.X);
+	CurrentY.Add(Location.Y);
+	CurrentZ.Add(Location.Z);
+
+	TrackedComps.Add(TrackedComp);
+	FrontToBackOnly.Add(bFrontToBackOnly);
+	return Actors.Add(Actor);
+}
+
+AActor* FPortalCrossingTracker::RemoveAtSwap(const int32 Index)
+{
+	if (Actors.IsValidIndex(Index) == false)
+		return nullptr;
+
+	Actors.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	TrackedComps.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	FrontToBackOnly.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	LastX.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	LastY.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	LastZ.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	CurrentX.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	CurrentY.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	CurrentZ.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+
+	return Actors.IsValidIndex(Index) ? Actors[Index] : nullptr;
+}
+
+void FPortalCrossingTracker::Reset()
+{
+	Actors.Reset();
+	TrackedComps.Reset();
+	FrontToBackOnly.Reset();
+
+	LastX.Reset();
+	LastY.Reset();
+	LastZ.Reset();
+
+	CurrentX.Reset();
+	CurrentY.Reset();
+	CurrentZ.Reset();
+}
+
+void FPortalCrossingTracker::SetLastLocation(const int32 Index, const FVector& Location)
+{
+	LastX[Index] = Location.X;
+	LastY[Index] = Location.Y;
+	LastZ[Index] = Location.Z;
+}
+
+void FPortalCrossingTracker::UpdateCurrentLocations()
+{
+	for (int32 Index = 0; Index < TrackedComps.Num(); Index++)
+	{
+		const FVector Location = TrackedComps[Index]->GetComponentLocation();
+		CurrentX[Index] = Location.X;
+		CurrentY[Index] = Location.Y;
+		CurrentZ[Index] = Location.Z;
+	}
+}
+
+void FPortalCrossingTracker::FindCrossings(const FPlane& Plane, TArray<int32>& OutCrossedIndices) const
+{
+	OutCrossedIndices.Reset();
+
+	const int32 Count = Actors.Num();
+	const int32 VectorCount = Count & ~3;
+
+	const VectorRegister4Double NormalX = VectorSetFloat1(Plane.X);
+	const VectorRegister4Double NormalY = VectorSetFloat1(Plane.Y);
+	const VectorRegister4Double NormalZ = VectorSetFloat1(Plane.Z);
+	const VectorRegister4Double PlaneW = VectorSetFloat1(Plane.W);
+	const VectorRegister4Double Zero = VectorZeroDouble();
+
+	// Four actors at a time: signed distances to the plane of both locations, then compare their sides
+	for (int32 Index = 0; Index < VectorCount; Index += 4)
+	{
+		const VectorRegister4Double LastDistance = VectorSubtract(
+			VectorMultiplyAdd(VectorLoad(&LastX[Index]), NormalX, VectorMultiplyAdd(VectorLoad(&LastY[Index]), NormalY, VectorMultiply(VectorLoad(&LastZ[Index]), NormalZ))), PlaneW);
+		const VectorRegister4Double CurrentDistance = VectorSubtract(
+			VectorMultiplyAdd(VectorLoad(&CurrentX[Index]), NormalX, VectorMultiplyAdd(VectorLoad(&CurrentY[Index]), NormalY, VectorMultiply(VectorLoad(&CurrentZ[Index]), NormalZ))), PlaneW);
+
+		const VectorRegister4Double LastInFront = VectorCompareGE(LastDistance, Zero);
+		const VectorRegister4Double CurrentInFront = VectorCompareGE(CurrentDistance, Zero);
+
+		const int32 CrossedMask = VectorMaskBits(VectorBitwiseXor(LastInFront, CurrentInFront));
+		if (CrossedMask == 0)
+			continue;
+
+		const int32 FrontToBackMask = VectorMaskBits(VectorBitwiseAnd(LastInFront, VectorCompareLT(CurrentDistance, Zero)));
+		for (int32 Lane = 0; Lane < 4; Lane++)
+		{
+			const int32 LaneMask = FrontToBackOnly[Index + Lane] ? FrontToBackMask : CrossedMask;
+			if (LaneMask & (1 << Lane))
+				OutCrossedIndices.Add(Index + Lane);
+		}
+	}
+
+	// Remaining actors
+	for (int32 Index = VectorCount; Index < Count; Index++)
+	{
+		const double LastDistance = Plane.PlaneDot(FVector(LastX[Index], LastY[Index], LastZ[Index]));
+		const double CurrentDistance = Plane.PlaneDot(FVector(CurrentX[Index], CurrentY[Index], CurrentZ[Index]));
+
+		const bool bLastInFront = LastDistance >= 0.0;
+		const bool bCurrentInFront = CurrentDistance >= 0.0;
+		if (bLastInFront == bCurrentInFront)
+			continue;
+
+		if (FrontToBackOnly[Index] == false || bLastInFront)
+			OutCrossedIndices.Add(Index);
+	}
+}
+
+void FPortalCrossingTracker::AdvanceLocations()
+{
+	const int32 Count = Actors.Num();
+
+	// The current locations become the reference for the next frame
+	FMemory::Memcpy(LastX.GetData(), CurrentX.GetData(), Count * sizeof(double));
+	FMemory::Memcpy(LastY.GetData(), CurrentY.GetData(), Count * sizeof(double));
+	FMemory::Memcpy(LastZ.GetData(), CurrentZ.GetData(), Count * sizeof(double));
+}
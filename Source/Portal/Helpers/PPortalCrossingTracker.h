@@ -0,0 +1,55 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/*
+ Structure of arrays holding the last and current tracked position of every actor overlapping a portal.
+ All the plane side and crossing tests are done in one vectorized pass, four actors at a time.
+ NOTE: Actors and components are not referenced for the garbage collector, the portal tracked actors map keeps them alive.
+ */
+struct FPortalCrossingTracker
+{
+	/* Start tracking an actor from the given location, returns its index. */
+	int32 Add(AActor* Actor, USceneComponent* TrackedComp, const FVector& Location, bool bFrontToBackOnly);
+
+	/* Stop tracking the actor at the given index, the last actor is moved in its place. Returns the actor that moved, if any. */
+	AActor* RemoveAtSwap(int32 Index);
+
+	void Reset();
+
+	/* Read the current location of every tracked component. */
+	void UpdateCurrentLocations();
+
+	/*
+	 Find the actors whose segment from the last to the current location crosses the plane.
+	 Actors added with bFrontToBackOnly only count when they started in front of the plane.
+	 */
+	void FindCrossings(const FPlane& Plane, TArray<int32>& OutCrossedIndices) const;
+
+	/* Make the current locations the last ones, once the crossings of this frame are handled. */
+	void AdvanceLocations();
+
+	int32 Num() const { return Actors.Num(); }
+	AActor* GetActor(const int32 Index) const { return Actors[Index]; }
+
+	FVector GetLastLocation(const int32 Index) const { return FVector(LastX[Index], LastY[Index], LastZ[Index]); }
+	FVector GetCurrentLocation(const int32 Index) const { return FVector(CurrentX[Index], CurrentY[Index], CurrentZ[Index]); }
+
+	/* Override where an actor was on the last frame, for actors that started being tracked after they entered. */
+	void SetLastLocation(int32 Index, const FVector& Location);
+
+private:
+	TArray<AActor*> Actors;
+	TArray<USceneComponent*> TrackedComps;
+	TArray<bool> FrontToBackOnly;
+
+	TArray<double> LastX;
+	TArray<double> LastY;
+	TArray<double> LastZ;
+
+	TArray<double> CurrentX;
+	TArray<double> CurrentY;
+	TArray<double> CurrentZ;
+};
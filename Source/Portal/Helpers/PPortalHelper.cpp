@@ -5,6 +5,7 @@
 
 #include "Engine/TextureRenderTarget2D.h"
 #include "Portal/Level/PPortal.h"
+#include "Portal/Level/PPortalWall.h"
 
 bool UPPortalHelper::IsPortalColliding(const FVector& OriginPortalA, const FVector2D& PortalAExtents, const FVector& OriginPortalB, const FVector2D& PortalBExtents)
 {
@@ -14,6 +15,16 @@ bool UPPortalHelper::IsPortalColliding(const FVector& OriginPortalA, const FVect
 	return bIsCollidingHorizontally && bIsCollidingVertically;
 }
 
+bool UPPortalHelper::IsPortalPlacementClear(const APPortal* OtherPortal, const APPortalWall* PortalWall, const FVector& PortalLocation, const FVector2D& PortalExtents)
+{
+	if (OtherPortal == nullptr || OtherPortal->CurrentWall != PortalWall)
+		return true;
+
+	const FVector OtherPortalRelativeLocation = PortalWall->GetTransform().InverseTransformPosition(OtherPortal->GetActorLocation());
+	const FVector PortalRelativeLocation = PortalWall->GetTransform().InverseTransformPosition(PortalLocation);
+	return IsPortalColliding(OtherPortalRelativeLocation, OtherPortal->Extents, PortalRelativeLocation, PortalExtents) == false;
+}
+
 void UPPortalHelper::ResizeRenderTarget(UTextureRenderTarget2D* RenderTarget, const float SizeX, const float SizeY)
 {
 	if (RenderTarget == nullptr)
@@ -27,32 +38,15 @@ FVector UPPortalHelper::ConvertLocationToPortalSpace(const FVector Location, APP
 	if (OriginPortal == nullptr || TargetPortal == nullptr)
 		return FVector::ZeroVector;
 
-	const FTransform OriginTransform = OriginPortal->GetPortalMesh()->GetComponentTransform();
-	const FTransform TargetTransform = TargetPortal->GetPortalMesh()->GetComponentTransform();
-
-	FVector RelativeLocation = OriginTransform.InverseTransformPositionNoScale(Location);
-	RelativeLocation.X *= -1; // Flip forward axis.
-	RelativeLocation.Y *= -1; // Flip right axis.
-	const FVector NewLocation = TargetTransform.TransformPositionNoScale(RelativeLocation);
-
-	return NewLocation;
+	return GetPortalSpaceTransform(OriginPortal, TargetPortal).TransformPosition(Location);
 }
 
 FVector UPPortalHelper::ConvertDirectionToPortalSpace(const FVector Direction, APPortal* OriginPortal, APPortal* TargetPortal)
 {
-	if (TargetPortal == nullptr)
+	if (OriginPortal == nullptr || TargetPortal == nullptr)
 		return FVector::ZeroVector;
 
-	FVector Dots;
-	Dots.X = FVector::DotProduct(Direction, OriginPortal->GetPortalMesh()->GetForwardVector());
-	Dots.Y = FVector::DotProduct(Direction, OriginPortal->GetPortalMesh()->GetRightVector());
-	Dots.Z = FVector::DotProduct(Direction, OriginPortal->GetPortalMesh()->GetUpVector());
-
-	const FVector NewDirection = Dots.X * -TargetPortal->GetPortalMesh()->GetForwardVector()
-								+ Dots.Y * -TargetPortal->GetPortalMesh()->GetRightVector()
-								+ Dots.Z * TargetPortal->GetPortalMesh()->GetUpVector();
-
-	return NewDirection;
+	return GetPortalSpaceTransform(OriginPortal, TargetPortal).TransformVectorNoScale(Direction);
 }
 
 FRotator UPPortalHelper::ConvertRotationToPortalSpace(const FRotator Rotation, APPortal* OriginPortal, APPortal* TargetPortal)
@@ -60,13 +54,98 @@ FRotator UPPortalHelper::ConvertRotationToPortalSpace(const FRotator Rotation, A
 	if (OriginPortal == nullptr || TargetPortal == nullptr)
 		return FRotator::ZeroRotator;
 
-	const FTransform OriginTransform = OriginPortal->GetPortalMesh()->GetComponentTransform();
-	const FTransform TargetTransform = TargetPortal->GetPortalMesh()->GetComponentTransform();
-	const FQuat QuatRotation = FQuat(Rotation);
+	return GetPortalSpaceTransform(OriginPortal, TargetPortal).TransformRotation(FQuat(Rotation)).Rotator();
+}
+
+void UPPortalHelper::ConvertTransformsToPortalSpace(TArrayView<FVector> Locations, TArrayView<FQuat> Rotations, APPortal* OriginPortal, APPortal* TargetPortal)
+{
+	if (OriginPortal == nullptr || TargetPortal == nullptr)
+		return;
+
+	const FTransform PortalSpaceTransform = GetPortalSpaceTransform(OriginPortal, TargetPortal);
+
+	for (FVector& Location : Locations)
+		Location = PortalSpaceTransform.TransformPosition(Location);
+
+	for (FQuat& Rotation : Rotations)
+		Rotation = PortalSpaceTransform.TransformRotation(Rotation);
+}
+
+FTransform UPPortalHelper::MakePortalSpaceTransform(const USceneComponent* OriginComponent, const USceneComponent* TargetComponent)
+{
+	const FTransform& OriginTransform = OriginComponent->GetComponentTransform();
+	const FTransform& TargetTransform = TargetComponent->GetComponentTransform();
+
+	// Into the origin portal space, flip the forward and right axes, then out of the target portal space
+	const FTransform OriginNoScale(OriginTransform.GetRotation(), OriginTransform.GetTranslation());
+	const FTransform TargetNoScale(TargetTransform.GetRotation(), TargetTransform.GetTranslation());
+	const FTransform Flip(FQuat(FVector::UpVector, UE_PI));
+
+	return OriginNoScale.Inverse() * Flip * TargetNoScale;
+}
+
+FTransform UPPortalHelper::GetPortalSpaceTransform(APPortal* OriginPortal, APPortal* TargetPortal)
+{
+	if (OriginPortal->GetLinkedPortal() == TargetPortal)
+		return OriginPortal->GetPortalSpaceTransform();
+
+	return MakePortalSpaceTransform(OriginPortal->GetPortalMesh(), TargetPortal->GetPortalMesh());
+}
+
+FMatrix UPPortalHelper::MakeViewMatrix(const FVector& Location, const FRotator& Rotation)
+{
+	// Swap axes so the camera looks down +Z like the renderer expects
+	const FMatrix ViewAxes = FMatrix(
+		FPlane(0, 0, 1, 0),
+		FPlane(1, 0, 0, 0),
+		FPlane(0, 1, 0, 0),
+		FPlane(0, 0, 0, 1));
+
+	return FTranslationMatrix(-Location) * FInverseRotationMatrix(Rotation) * ViewAxes;
+}
+
+bool UPPortalHelper::MakeObliqueProjectionMatrix(const FMatrix& ProjectionMatrix, const FMatrix& ViewMatrix, const FPlane& WorldClipPlane, FMatrix& OutProjectionMatrix)
+{
+	OutProjectionMatrix = ProjectionMatrix;
+
+	// Clip plane in view space as a 4D vector, so that Dot4(ClipPlane, (X, Y, Z, 1)) is the signed distance to the plane
+	const FPlane ViewPlane = WorldClipPlane.TransformBy(ViewMatrix);
+	FVector4 ClipPlane(ViewPlane.X, ViewPlane.Y, ViewPlane.Z, -ViewPlane.W);
+
+	// The camera (view space origin) must be behind the plane, otherwise the new near plane would cut in front of it.
+	// Move the plane back instead of giving up, only the sliver between the camera and the portal is then left unclipped
+	const double MinCameraDistance = 1.0;
+	if (ClipPlane.W > -MinCameraDistance)
+		ClipPlane.W = -MinCameraDistance;
+
+	const FMatrix InverseProjection = ProjectionMatrix.Inverse();
+
+	// Clip plane in clip space, used to find the frustum corner the far plane has to go through
+	FVector4 ClipSpacePlane;
+	for (int32 Row = 0; Row < 4; Row++)
+	{
+		ClipSpacePlane[Row] = InverseProjection.M[Row][0] * ClipPlane.X + InverseProjection.M[Row][1] * ClipPlane.Y
+			+ InverseProjection.M[Row][2] * ClipPlane.Z + InverseProjection.M[Row][3] * ClipPlane.W;
+	}
+
+	// Far corner of the frustum on the visible side of the plane, with reversed Z the far plane is at depth 0
+	const FVector4 ClipSpaceCorner(FMath::Sign(ClipSpacePlane.X), FMath::Sign(ClipSpacePlane.Y), 0.0f, 1.0f);
+	const FVector4 Corner = InverseProjection.TransformFVector4(ClipSpaceCorner);
+
+	// Projection columns producing clip space Z and W
+	const FVector4 ColumnW(ProjectionMatrix.M[0][3], ProjectionMatrix.M[1][3], ProjectionMatrix.M[2][3], ProjectionMatrix.M[3][3]);
+
+	const double PlaneDotCorner = Dot4(ClipPlane, Corner);
+	if (FMath::Abs(PlaneDotCorner) <= UE_SMALL_NUMBER)
+		return false;
+
+	// Scale the plane so the new far plane goes through the corner, then W - Z is the clip plane: that's the new near plane
+	const double Scale = Dot4(ColumnW, Corner) / PlaneDotCorner;
+	if (Scale <= 0.0)
+		return false;
 
-	FRotator RelativeRotation = OriginTransform.InverseTransformRotation(QuatRotation).Rotator();
-	RelativeRotation.Yaw += 180.0f; // Flip rotation
-	const FQuat NewWorldQuat = TargetTransform.TransformRotation(RelativeRotation.Quaternion());
+	for (int32 Row = 0; Row < 4; Row++)
+		OutProjectionMatrix.M[Row][2] = ColumnW[Row] - Scale * ClipPlane[Row];
 
-	return NewWorldQuat.Rotator();
+	return true;
 }
@@ -13,6 +13,7 @@
 #define ECC_PortalBox ECC_GameTraceChannel5
 
 class APPortal;
+class APPortalWall;
 
 /**
  * 
@@ -26,6 +27,9 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	static bool IsPortalColliding(const FVector& OriginPortalA, const FVector2D& PortalAExtents, const FVector& OriginPortalB, const FVector2D& PortalBExtents);
 
+	/* Whether a portal placed on a wall stays clear of another portal, always true if the other portal is on another wall. */
+	static bool IsPortalPlacementClear(const APPortal* OtherPortal, const APPortalWall* PortalWall, const FVector& PortalLocation, const FVector2D& PortalExtents);
+
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	static void ResizeRenderTarget(UTextureRenderTarget2D* RenderTarget, float SizeX, float SizeY);
 
@@ -37,4 +41,24 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	static FRotator ConvertRotationToPortalSpace(FRotator Rotation, APPortal* OriginPortal, APPortal* TargetPortal);
+
+	/* Convert locations and rotations from the origin portal space to the target portal space in place, fetching the portal transform only once. */
+	static void ConvertTransformsToPortalSpace(TArrayView<FVector> Locations, TArrayView<FQuat> Rotations, APPortal* OriginPortal, APPortal* TargetPortal);
+
+	/* Transform taking a world location in front of the origin portal to the matching location in front of the target portal, ignoring scale. */
+	static FTransform MakePortalSpaceTransform(const USceneComponent* OriginComponent, const USceneComponent* TargetComponent);
+
+	/* Portal space transform of a pair of portals, from the origin portal cache when the target is its linked portal. */
+	static FTransform GetPortalSpaceTransform(APPortal* OriginPortal, APPortal* TargetPortal);
+
+	/* Build the view matrix (world to view space, Unreal view axes) of a camera at the given location and rotation. */
+	static FMatrix MakeViewMatrix(const FVector& Location, const FRotator& Rotation);
+
+	/*
+	 Fold a world space clip plane into the near plane of a reversed Z perspective projection (oblique view frustum).
+	 Everything on the back side of the plane is clipped by the projection itself, without needing a global clip plane.
+	 If the camera isn't at least a centimeter behind the plane, the plane is moved so that it is.
+	 Returns false if no oblique projection can be made for the view.
+	 */
+	static bool MakeObliqueProjectionMatrix(const FMatrix& ProjectionMatrix, const FMatrix& ViewMatrix, const FPlane& WorldClipPlane, FMatrix& OutProjectionMatrix);
 };
@@ -0,0 +1,80 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalPhysicsCallback.h"
+
+#include "PhysicsProxy/SingleParticlePhysicsProxy.h"
+#include "Portal/Level/PPortal.h"
+
+bool FPortalPhysicsPortal::IsWithinOpening(const FVector& PointOnPlane) const
+{
+	if (Extents.IsNearlyZero())
+		return true;
+
+	const FVector LocalPoint = PortalTransform.InverseTransformPositionNoScale(PointOnPlane);
+	return FMath::Abs(LocalPoint.Y) <= Extents.X && FMath::Abs(LocalPoint.Z) <= Extents.Y;
+}
+
+FName FPortalPhysicsCallback::GetFNameForStatId() const
+{
+	const static FLazyName StaticName("FPortalPhysicsCallback");
+	return StaticName;
+}
+
+void FPortalPhysicsCallback::OnPreSimulate_Internal()
+{
+	if (const FPortalPhysicsInput* Input = GetConsumerInput_Internal())
+	{
+		Portals = Input->Portals;
+		Bodies = Input->Bodies;
+		Gravity = Input->Gravity;
+	}
+
+	if (Bodies.Num() == 0)
+		return;
+
+	const double DeltaTime = GetDeltaTime_Internal();
+	FPortalPhysicsOutput& Output = GetProducerOutputData_Internal();
+
+	for (int32 Index = Bodies.Num() - 1; Index >= 0; Index--)
+	{
+		const FPortalPhysicsBody& Body = Bodies[Index];
+		Chaos::FRigidBodyHandle_Internal* Handle = Body.Proxy ? Body.Proxy->GetPhysicsThreadAPI() : nullptr;
+		if (Handle == nullptr || Handle->ObjectState() != Chaos::EObjectStateType::Dynamic || Portals.IsValidIndex(Body.Portal) == false)
+			continue;
+
+		const FPortalPhysicsPortal& Portal = Portals[Body.Portal];
+		const FVector Location = Handle->GetX();
+		const FVector Velocity = Handle->V();
+		const FVector BodyGravity = Handle->GravityEnabled() ? Gravity : FVector::ZeroVector;
+
+		// Only bodies going from the front to the back of the portal plane during this step
+		const FVector NextLocation = Location + Velocity * DeltaTime + BodyGravity * (0.5 * DeltaTime * DeltaTime);
+		const double StartDistance = Portal.Plane.PlaneDot(Location);
+		const double EndDistance = Portal.Plane.PlaneDot(NextLocation);
+		if (StartDistance < 0.0 || EndDistance >= 0.0)
+			continue;
+
+		const double CrossingAlpha = StartDistance / (StartDistance - EndDistance);
+		if (Portal.IsWithinOpening(FMath::Lerp(Location, NextLocation, CrossingAlpha)) == false)
+			continue;
+
+		// Move the body to where it crosses the target plane, pushed just in front of it so it is never placed inside the target wall.
+		// The step then runs in full from there, the body ends it ahead by the distance it would have covered before the crossing.
+		const FTransform& PortalSpaceTransform = Portal.PortalSpaceTransform;
+		const double CrossingTime = CrossingAlpha * DeltaTime;
+		const FVector CrossingLocation = Location + Velocity * CrossingTime + BodyGravity * (0.5 * CrossingTime * CrossingTime);
+		const FVector CrossingVelocity = Velocity + BodyGravity * CrossingTime;
+		const FVector ExitNormal = PortalSpaceTransform.TransformVectorNoScale(-FVector(Portal.Plane));
+
+		Handle->SetX(PortalSpaceTransform.TransformPosition(CrossingLocation) + ExitNormal * ExitOffset);
+		Handle->SetR(PortalSpaceTransform.TransformRotation(FQuat(Handle->GetR())));
+		Handle->SetV(PortalSpaceTransform.TransformVectorNoScale(CrossingVelocity));
+		Handle->SetW(PortalSpaceTransform.TransformVectorNoScale(Handle->W()));
+
+		Output.Teleports.Add({ Body.Actor, Portal.Portal });
+
+		// The body belongs to the target portal now, the game thread sends it again once tracked there
+		Bodies.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	}
+}
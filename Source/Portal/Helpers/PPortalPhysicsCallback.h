@@ -0,0 +1,94 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Chaos/SimCallbackInput.h"
+#include "Chaos/SimCallbackObject.h"
+
+class APPortal;
+
+namespace Chaos
+{
+	class FSingleParticlePhysicsProxy;
+}
+
+/* A linked portal as seen from the physics thread, a snapshot of the game thread portal. */
+struct FPortalPhysicsPortal
+{
+	TWeakObjectPtr<APPortal> Portal;
+
+	FPlane Plane;
+	FTransform PortalTransform;
+	FTransform PortalSpaceTransform;
+
+	/* Half size of the opening, zero when the whole plane counts. */
+	FVector2D Extents;
+
+	bool IsWithinOpening(const FVector& PointOnPlane) const;
+};
+
+/* A simulated body tracked by a portal. */
+struct FPortalPhysicsBody
+{
+	TWeakObjectPtr<AActor> Actor;
+	Chaos::FSingleParticlePhysicsProxy* Proxy = nullptr;
+
+	/* Index of the portal tracking the body in the portal list. */
+	int32 Portal = INDEX_NONE;
+};
+
+/* Portals and bodies sent by the game thread, only when the tracked bodies or the portals changed. */
+struct FPortalPhysicsInput : public Chaos::FSimCallbackInput
+{
+	TArray<FPortalPhysicsPortal> Portals;
+	TArray<FPortalPhysicsBody> Bodies;
+	FVector Gravity = FVector::ZeroVector;
+
+	void Reset()
+	{
+		Portals.Reset();
+		Bodies.Reset();
+	}
+};
+
+/* A body moved to the other side of a portal during a physics step. */
+struct FPortalPhysicsTeleport
+{
+	TWeakObjectPtr<AActor> Actor;
+	TWeakObjectPtr<APPortal> Portal;
+};
+
+/* Teleports done by a physics step, for the game thread to update the portal tracking. */
+struct FPortalPhysicsOutput : public Chaos::FSimCallbackOutput
+{
+	TArray<FPortalPhysicsTeleport> Teleports;
+
+	void Reset()
+	{
+		Teleports.Reset();
+	}
+};
+
+/*
+ Physics thread portal crossing of simulated bodies, opt-in with sm.PortalAsyncPhysics.
+ Before each step, a body whose path for the step goes through a portal opening is moved to its crossing point on the target portal
+ with its velocity at the crossing converted, so it leaves the target portal during the step and is never resolved inside the wall.
+ The game thread only sends the body list when it changes and reads back the teleports to update the tracking.
+ */
+class FPortalPhysicsCallback : public Chaos::TSimCallbackObject<FPortalPhysicsInput, FPortalPhysicsOutput, Chaos::ESimCallbackOptions::Presimulate>
+{
+public:
+	virtual FName GetFNameForStatId() const override;
+
+private:
+	virtual void OnPreSimulate_Internal() override;
+
+	/* Distance in front of the target portal plane a crossing body is placed at, keeps it out of the target wall despite rounding. */
+	static constexpr double ExitOffset = 0.1;
+
+	/* Last input received, the game thread doesn't send one every step. */
+	TArray<FPortalPhysicsPortal> Portals;
+	TArray<FPortalPhysicsBody> Bodies;
+	FVector Gravity = FVector::ZeroVector;
+};
@@ -0,0 +1,92 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalProxyBatch.h"
+
+#include "Components/InstancedStaticMeshComponent.h"
+
+void FPortalProxyBatch::Init(AActor* Owner, const UStaticMeshComponent* Source)
+{
+	Mesh = Source->GetStaticMesh();
+	for (int32 Slot = 0; Slot < Source->GetNumMaterials(); Slot++)
+		Materials.Add(Source->GetMaterial(Slot));
+
+	VisibleInstances = CreateInstances(Owner, *this, true, false);
+	ShadowInstances = CreateInstances(Owner, *this, false, true);
+}
+
+bool FPortalProxyBatch::Matches(const UStaticMeshComponent* Source) const
+{
+	if (Source->GetStaticMesh() != Mesh || Source->GetNumMaterials() != Materials.Num())
+		return false;
+
+	for (int32 Slot = 0; Slot < Materials.Num(); Slot++)
+	{
+		if (Source->GetMaterial(Slot) != Materials[Slot])
+			return false;
+	}
+
+	return true;
+}
+
+int32 FPortalProxyBatch::Allocate()
+{
+	if (FreeInstances.Num() > 0)
+		return FreeInstances.Pop(EAllowShrinking::No);
+
+	const FTransform Hidden(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+	ShadowInstances->AddInstance(Hidden, true);
+	return VisibleInstances->AddInstance(Hidden, true);
+}
+
+void FPortalProxyBatch::Free(const int32 Instance)
+{
+	// Removing would shift the indices of the other instances, scale it down to nothing instead
+	const FTransform Hidden(FQuat::Identity, FVector::ZeroVector, FVector::ZeroVector);
+	VisibleInstances->UpdateInstanceTransform(Instance, Hidden, true, false, true);
+	ShadowInstances->UpdateInstanceTransform(Instance, Hidden, true, false, true);
+	bRenderStateDirty = true;
+
+	FreeInstances.Add(Instance);
+}
+
+void FPortalProxyBatch::SetInstanceTransform(const int32 Instance, const FTransform& Transform, const bool bVisible)
+{
+	const FTransform Hidden(Transform.GetRotation(), Transform.GetLocation(), FVector::ZeroVector);
+	VisibleInstances->UpdateInstanceTransform(Instance, bVisible ? Transform : Hidden, true, false, true);
+	ShadowInstances->UpdateInstanceTransform(Instance, Transform, true, false, true);
+	bRenderStateDirty = true;
+}
+
+void FPortalProxyBatch::MarkRenderStateDirty()
+{
+	if (bRenderStateDirty == false)
+		return;
+
+	VisibleInstances->MarkRenderStateDirty();
+	ShadowInstances->MarkRenderStateDirty();
+	bRenderStateDirty = false;
+}
+
+UInstancedStaticMeshComponent* FPortalProxyBatch::CreateInstances(AActor* Owner, const FPortalProxyBatch& Batch, const bool bRenderInMainPass, const bool bCastShadow)
+{
+	UInstancedStaticMeshComponent* Instances = NewObject<UInstancedStaticMeshComponent>(Owner, NAME_None, RF_Transient);
+	Instances->SetMobility(EComponentMobility::Movable);
+	Instances->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Instances->SetCanEverAffectNavigation(false);
+	Instances->SetStaticMesh(Batch.Mesh);
+	for (int32 Slot = 0; Slot < Batch.Materials.Num(); Slot++)
+		Instances->SetMaterial(Slot, Batch.Materials[Slot]);
+
+	Instances->SetRenderInMainPass(bRenderInMainPass);
+	Instances->SetCastShadow(bCastShadow);
+
+	// Instances are placed in world space, keep the component at the origin whatever its owner does
+	Instances->SetUsingAbsoluteLocation(true);
+	Instances->SetUsingAbsoluteRotation(true);
+	Instances->SetUsingAbsoluteScale(true);
+	Instances->SetWorldTransform(FTransform::Identity);
+	Instances->RegisterComponent();
+
+	return Instances;
+}
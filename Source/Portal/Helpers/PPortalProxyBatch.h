@@ -0,0 +1,70 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PPortalProxyBatch.generated.h"
+
+class UInstancedStaticMeshComponent;
+class UStaticMeshComponent;
+
+/* One static mesh of a tracked actor drawn by a proxy batch. */
+struct FPortalProxyInstance
+{
+	int32 Batch;
+	int32 Instance;
+
+	/* Transform of the mesh component relative to its actor. */
+	FTransform RelativeTransform;
+};
+
+/*
+ Render only copies of every static mesh sharing the same mesh and materials, drawn with instancing and without any collision.
+ Each instance lives in two components: one casting shadows only, and one drawn in the main pass without shadows that is
+ scaled down to nothing while the instance is hidden, so hidden copies keep casting shadows like the actor copies.
+ */
+USTRUCT()
+struct FPortalProxyBatch
+{
+	GENERATED_BODY()
+
+	/* Create the instanced components drawing the source mesh with its materials, owned by Owner. */
+	void Init(AActor* Owner, const UStaticMeshComponent* Source);
+
+	bool Matches(const UStaticMeshComponent* Source) const;
+
+	/* Reserve an instance, reusing a freed one if possible. */
+	int32 Allocate();
+
+	/* Hide an instance and give it back to the batch. */
+	void Free(int32 Instance);
+
+	void SetInstanceTransform(int32 Instance, const FTransform& Transform, bool bVisible);
+
+	/* Send the instance updates made since the last call to the renderer, once for the whole batch. */
+	void MarkRenderStateDirty();
+
+	UPROPERTY()
+	TObjectPtr<UStaticMesh> Mesh;
+
+	UPROPERTY()
+	TArray<TObjectPtr<UMaterialInterface>> Materials;
+
+	UPROPERTY()
+	TObjectPtr<UInstancedStaticMeshComponent> VisibleInstances;
+
+	UPROPERTY()
+	TObjectPtr<UInstancedStaticMeshComponent> ShadowInstances;
+
+	TArray<int32> FreeInstances;
+
+	/* Whether instances were updated without marking the components render state dirty. */
+	bool bRenderStateDirty;
+
+	FPortalProxyBatch() : Mesh(nullptr), VisibleInstances(nullptr), ShadowInstances(nullptr), bRenderStateDirty(false)
+	{
+	}
+
+private:
+	static UInstancedStaticMeshComponent* CreateInstances(AActor* Owner, const FPortalProxyBatch& Batch, bool bRenderInMainPass, bool bCastShadow);
+};
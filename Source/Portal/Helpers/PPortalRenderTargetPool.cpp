@@ -0,0 +1,108 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalRenderTargetPool.h"
+
+#include "PPortalHelper.h"
+#include "PixelFormat.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Portal/Portal.h"
+
+/* GPU memory of a render target, for the portal render target memory stat. */
+static int64 GetRenderTargetBytes(const UTextureRenderTarget2D* RenderTarget)
+{
+	return static_cast<int64>(RenderTarget->SizeX) * RenderTarget->SizeY * GPixelFormats[RenderTarget->GetFormat()].BlockBytes;
+}
+
+UTextureRenderTarget2D* FPortalRenderTargetPool::FindOrCreate(UObject* Outer, const UObject* Owner, const int32 Bucket, const int32 Level, const int32 SizeX, const int32 SizeY)
+{
+	for (const FPooledPortalRenderTarget& Entry : Entries)
+	{
+		if (Entry.Owner != Owner || Entry.Bucket != Bucket || Entry.Level != Level || Entry.RenderTarget == nullptr)
+			continue;
+
+		// Only touch the resource when the viewport size changed
+		if (Entry.RenderTarget->SizeX != SizeX || Entry.RenderTarget->SizeY != SizeY)
+		{
+			DEC_MEMORY_STAT_BY(STAT_PortalRenderTargetMemory, GetRenderTargetBytes(Entry.RenderTarget));
+			UPPortalHelper::ResizeRenderTarget(Entry.RenderTarget, SizeX, SizeY);
+			INC_MEMORY_STAT_BY(STAT_PortalRenderTargetMemory, GetRenderTargetBytes(Entry.RenderTarget));
+		}
+
+		return Entry.RenderTarget;
+	}
+
+	FPooledPortalRenderTarget& NewEntry = Entries.AddDefaulted_GetRef();
+	NewEntry.Owner = Owner;
+	NewEntry.Bucket = Bucket;
+	NewEntry.Level = Level;
+	NewEntry.RenderTarget = CreateRenderTarget(Outer, SizeX, SizeY);
+
+	return NewEntry.RenderTarget;
+}
+
+UTextureRenderTarget2D* FPortalRenderTargetPool::FindAny(const UObject* Owner, const int32 Level) const
+{
+	for (const FPooledPortalRenderTarget& Entry : Entries)
+	{
+		if (Entry.Owner == Owner && Entry.Level == Level && Entry.RenderTarget != nullptr)
+			return Entry.RenderTarget;
+	}
+
+	return nullptr;
+}
+
+void FPortalRenderTargetPool::ReleaseOwner(const UObject* Owner)
+{
+	for (int32 i = Entries.Num() - 1; i >= 0; i--)
+	{
+		if (Entries[i].Owner != Owner)
+			continue;
+
+		if (IsValid(Entries[i].RenderTarget))
+		{
+			DEC_MEMORY_STAT_BY(STAT_PortalRenderTargetMemory, GetRenderTargetBytes(Entries[i].RenderTarget));
+			Entries[i].RenderTarget->ReleaseResource();
+		}
+
+		Entries.RemoveAtSwap(i);
+	}
+}
+
+void FPortalRenderTargetPool::Reset()
+{
+	for (const FPooledPortalRenderTarget& Entry : Entries)
+	{
+		if (IsValid(Entry.RenderTarget))
+		{
+			DEC_MEMORY_STAT_BY(STAT_PortalRenderTargetMemory, GetRenderTargetBytes(Entry.RenderTarget));
+			Entry.RenderTarget->ReleaseResource();
+		}
+	}
+
+	Entries.Reset();
+}
+
+UTextureRenderTarget2D* FPortalRenderTargetPool::CreateRenderTarget(UObject* Outer, const int32 SizeX, const int32 SizeY)
+{
+	const FName TargetName = MakeUniqueObjectName(Outer, UTextureRenderTarget2D::StaticClass(), FName("PortalRenderTarget"));
+	UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(Outer, UTextureRenderTarget2D::StaticClass(), TargetName);
+	check(RenderTarget);
+
+	RenderTarget->RenderTargetFormat = RTF_RGBA16f;
+	RenderTarget->SizeX = SizeX;
+	RenderTarget->SizeY = SizeY;
+	RenderTarget->ClearColor = FLinearColor::Black;
+	RenderTarget->TargetGamma = 2.2f;
+	RenderTarget->bNeedsTwoCopies = false;
+	RenderTarget->bCanCreateUAV = false;
+
+	// Not needed since the texture is displayed on screen directly
+	RenderTarget->bAutoGenerateMips = false;
+
+	// This forces the engine to create the render target with the parameters we defined just above
+	RenderTarget->UpdateResource();
+	INC_MEMORY_STAT_BY(STAT_PortalRenderTargetMemory, GetRenderTargetBytes(RenderTarget));
+
+	return RenderTarget;
+}
@@ -0,0 +1,58 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PPortalRenderTargetPool.generated.h"
+
+class UTextureRenderTarget2D;
+
+/* A render target owned by the pool along with the owner, resolution bucket and recursion level it was created for. */
+USTRUCT()
+struct FPooledPortalRenderTarget
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<UTextureRenderTarget2D> RenderTarget;
+
+	/* Object the target is reserved for, only used as a key. Shared targets have no owner. */
+	const UObject* Owner;
+
+	int32 Bucket;
+	int32 Level;
+
+	FPooledPortalRenderTarget() : RenderTarget(nullptr), Owner(nullptr), Bucket(INDEX_NONE), Level(INDEX_NONE)
+	{
+	}
+};
+
+/*
+ Pool of portal render targets, one per owner, resolution bucket and recursion level.
+ Switching between buckets swaps textures instead of reallocating GPU memory, only a viewport size change resizes a target.
+ */
+USTRUCT()
+struct FPortalRenderTargetPool
+{
+	GENERATED_BODY()
+
+	/* Returns the render target of the given owner, bucket and level, creating it in Outer or resizing it to the requested size if needed. */
+	UTextureRenderTarget2D* FindOrCreate(UObject* Outer, const UObject* Owner, int32 Bucket, int32 Level, int32 SizeX, int32 SizeY);
+
+	/* Returns any existing render target of the given owner and recursion level, whatever its bucket, or nullptr. */
+	UTextureRenderTarget2D* FindAny(const UObject* Owner, int32 Level) const;
+
+	/* Releases the render targets reserved for an owner. */
+	void ReleaseOwner(const UObject* Owner);
+
+	/* Releases every pooled render target. */
+	void Reset();
+
+	int32 Num() const { return Entries.Num(); }
+
+private:
+	static UTextureRenderTarget2D* CreateRenderTarget(UObject* Outer, int32 SizeX, int32 SizeY);
+
+	UPROPERTY()
+	TArray<FPooledPortalRenderTarget> Entries;
+};
@@ -0,0 +1,203 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalTrackedActors.h"
+
+#include "Engine/World.h"
+#include "Portal/Level/PPortal.h"
+
+FTrackedActorHandle FPortalTrackedActors::Add(AActor* Actor, USceneComponent* TrackedComp, const bool bFrontToBackOnly)
+{
+	check(Actor && TrackedComp);
+	check(Contains(Actor) == false);
+
+	int32 Slot;
+	if (FreeSlots.Num() > 0)
+	{
+		Slot = FreeSlots.Pop(EAllowShrinking::No);
+	}
+	else
+	{
+		Slot = SlotIndices.Add(INDEX_NONE);
+		SlotGenerations.Add(0);
+	}
+
+	FTrackedActor& Entry = Entries.AddDefaulted_GetRef();
+	Entry.Actor = Actor;
+	Entry.TrackedComp = TrackedComp;
+	Entry.Slot = Slot;
+
+	const int32 Index = CrossingTracker.Add(Actor, TrackedComp, TrackedComp->GetComponentLocation(), bFrontToBackOnly);
+	check(Index == Entries.Num() - 1);
+
+	SlotIndices[Slot] = Index;
+	ActorSlots.Add(Actor, Slot);
+
+	FTrackedActorHandle Handle;
+	Handle.Slot = Slot;
+	Handle.Generation = SlotGenerations[Slot];
+	return Handle;
+}
+
+bool FPortalTrackedActors::Remove(const AActor* Actor)
+{
+	const int32* Slot = ActorSlots.Find(Actor);
+	if (Slot == nullptr)
+		return false;
+
+	RemoveAt(SlotIndices[*Slot]);
+	return true;
+}
+
+bool FPortalTrackedActors::Remove(const FTrackedActorHandle Handle)
+{
+	const FTrackedActor* Entry = Find(Handle);
+	if (Entry == nullptr)
+		return false;
+
+	RemoveAt(SlotIndices[Handle.Slot]);
+	return true;
+}
+
+void FPortalTrackedActors::RemoveAt(const int32 Index)
+{
+	const int32 Slot = Entries[Index].Slot;
+	ActorSlots.Remove(Entries[Index].Actor);
+
+	// Bump the generation so handles to the removed actor don't resolve to the next one using the slot
+	SlotIndices[Slot] = INDEX_NONE;
+	SlotGenerations[Slot]++;
+	FreeSlots.Add(Slot);
+
+	// Both arrays swap the same last entry in
+	Entries.RemoveAtSwap(Index, 1, EAllowShrinking::No);
+	CrossingTracker.RemoveAtSwap(Index);
+
+	if (Entries.IsValidIndex(Index))
+		SlotIndices[Entries[Index].Slot] = Index;
+}
+
+void FPortalTrackedActors::Reset()
+{
+	Entries.Reset();
+	CrossingTracker.Reset();
+	SlotIndices.Reset();
+	SlotGenerations.Reset();
+	FreeSlots.Reset();
+	ActorSlots.Reset();
+}
+
+FTrackedActor* FPortalTrackedActors::Find(const AActor* Actor)
+{
+	const int32* Slot = ActorSlots.Find(Actor);
+	return Slot ? &Entries[SlotIndices[*Slot]] : nullptr;
+}
+
+FTrackedActor* FPortalTrackedActors::Find(const FTrackedActorHandle Handle)
+{
+	if (SlotIndices.IsValidIndex(Handle.Slot) == false || SlotGenerations[Handle.Slot] != Handle.Generation)
+		return nullptr;
+
+	const int32 Index = SlotIndices[Handle.Slot];
+	return Index != INDEX_NONE ? &Entries[Index] : nullptr;
+}
+
+int32 FPortalTrackedActors::IndexOf(const AActor* Actor) const
+{
+	const int32* Slot = ActorSlots.Find(Actor);
+	return Slot ? SlotIndices[*Slot] : INDEX_NONE;
+}
+
+FTrackedActorHandle FPortalTrackedActors::FindHandle(const AActor* Actor) const
+{
+	FTrackedActorHandle Handle;
+	if (const int32* Slot = ActorSlots.Find(Actor))
+	{
+		Handle.Slot = *Slot;
+		Handle.Generation = SlotGenerations[*Slot];
+	}
+
+	return Handle;
+}
+
+FTrackedActorHandle FPortalTrackedActors::GetHandle(const int32 Index) const
+{
+	FTrackedActorHandle Handle;
+	Handle.Slot = Entries[Index].Slot;
+	Handle.Generation = SlotGenerations[Handle.Slot];
+	return Handle;
+}
+
+#if !UE_BUILD_SHIPPING
+
+/* Per frame cost of the portal tracking bookkeeping for 1 to 1000 tracked actors: reading locations, crossing pass, lookups and churn. */
+static void RunPortalTrackingBenchmark(const TArray<FString>& Args, UWorld* World)
+{
+	if (World == nullptr)
+		return;
+
+	const int32 Frames = Args.Num() > 0 ? FMath::Max(1, FCString::Atoi(*Args[0])) : 200;
+	const FPlane PortalPlane(FVector::ZeroVector, FVector::ForwardVector);
+	FRandomStream Random(42);
+
+	for (const int32 Count : {1, 10, 100, 1000})
+	{
+		// Bare actors with a root component scattered on both sides of the plane
+		TArray<AActor*> Actors;
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.ObjectFlags |= RF_Transient;
+		for (int32 i = 0; i < Count; i++)
+		{
+			AActor* Actor = World->SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+			USceneComponent* Root = NewObject<USceneComponent>(Actor);
+			Actor->SetRootComponent(Root);
+			Root->RegisterComponent();
+			Root->SetWorldLocation(Random.GetPointInBoundingBox(FVector::ZeroVector, FVector(100.0)));
+			Actors.Add(Actor);
+		}
+
+		FPortalTrackedActors TrackedActors;
+		for (AActor* Actor : Actors)
+			TrackedActors.Add(Actor, Actor->GetRootComponent(), false);
+
+		TArray<int32> CrossedIndices;
+		const int32 Churn = FMath::Max(1, Count / 10);
+		const double StartTime = FPlatformTime::Seconds();
+		for (int32 Frame = 0; Frame < Frames; Frame++)
+		{
+			FPortalCrossingTracker& CrossingTracker = TrackedActors.GetCrossingTracker();
+			CrossingTracker.UpdateCurrentLocations();
+			CrossingTracker.FindCrossings(PortalPlane, CrossedIndices);
+			CrossingTracker.AdvanceLocations();
+
+			// In place update of every entry, like the copy update
+			for (FTrackedActor& Tracked : TrackedActors)
+				Tracked.bCopyVisible = !Tracked.bCopyVisible;
+
+			// Overlap events look actors up, and some stop and start being tracked every frame
+			for (int32 i = 0; i < Churn; i++)
+			{
+				AActor* Actor = Actors[(Frame * Churn + i) % Count];
+				if (TrackedActors.Find(Actor) != nullptr)
+					TrackedActors.Remove(Actor);
+
+				TrackedActors.Add(Actor, Actor->GetRootComponent(), false);
+			}
+		}
+
+		const double FrameTimeUs = (FPlatformTime::Seconds() - StartTime) * 1000000.0 / Frames;
+		UE_LOG(LogPortal, Display, TEXT("Portal tracking, %4d actors: %8.2f us per frame (%d frames)"), Count, FrameTimeUs, Frames);
+
+		TrackedActors.Reset();
+		for (AActor* Actor : Actors)
+			Actor->Destroy();
+	}
+}
+
+static FAutoConsoleCommandWithWorldAndArgs PortalTrackingBenchmarkCommand(
+	TEXT("sm.PortalTrackingBenchmark"),
+	TEXT("Measure the per frame cost of tracking 1, 10, 100 and 1000 actors in a portal. Optional argument: number of frames"),
+	FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RunPortalTrackingBenchmark),
+	ECVF_Cheat);
+
+#endif
@@ -0,0 +1,112 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "PPortalCrossingTracker.h"
+#include "PPortalProxyBatch.h"
+#include "PPortalTrackedActors.generated.h"
+
+/* Structure to hold important tracking information with each overlapping actor. */
+USTRUCT(BlueprintType)
+struct FTrackedActor
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	AActor* Actor;
+
+	UPROPERTY()
+	USceneComponent* TrackedComp;
+
+	UPROPERTY()
+	AActor* TrackedCopy;
+
+	/* Instanced copies of the actor meshes, used instead of TrackedCopy when the portal uses instanced copies. */
+	TArray<FPortalProxyInstance> Proxies;
+
+	/* Whether the copy is drawn in the main pass, it always casts shadows. */
+	bool bCopyVisible;
+
+	/* Tracked ahead of overlapping the portal box because it is about to go through the portal at high speed. */
+	bool bSpeculative;
+
+	/* Collision profile of a speculative actor before it was set to pass through the portal wall, restored if it doesn't go through. */
+	FName SpeculativeProfileName;
+
+	/* Handle slot of the entry, see FPortalTrackedActors. */
+	int32 Slot;
+
+	FTrackedActor() : Actor(nullptr), TrackedComp(nullptr), TrackedCopy(nullptr), bCopyVisible(false), bSpeculative(false), SpeculativeProfileName(NAME_None), Slot(INDEX_NONE)
+	{
+	}
+};
+
+/* Stable reference to a tracked actor, invalidated when the actor stops being tracked even if its slot is reused. */
+struct FTrackedActorHandle
+{
+	int32 Slot = INDEX_NONE;
+	uint32 Generation = 0;
+
+	bool IsValid() const { return Slot != INDEX_NONE; }
+
+	bool operator==(const FTrackedActorHandle& Other) const { return Slot == Other.Slot && Generation == Other.Generation; }
+};
+
+/*
+ Actors tracked by a portal, stored densely so the per-frame loops walk contiguous memory and entries are updated in place.
+ Removal swaps the last entry in, handles go through a slot table so they survive the swap.
+ The crossing tracker is kept in the same order, the crossing index of an entry is its dense index.
+ */
+USTRUCT()
+struct FPortalTrackedActors
+{
+	GENERATED_BODY()
+
+	/* Start tracking an actor, the location of TrackedComp is the one tested against the portal plane. */
+	FTrackedActorHandle Add(AActor* Actor, USceneComponent* TrackedComp, bool bFrontToBackOnly);
+
+	/* Stop tracking an actor in constant time. Returns false if it wasn't tracked. */
+	bool Remove(const AActor* Actor);
+	bool Remove(FTrackedActorHandle Handle);
+
+	void Reset();
+
+	FTrackedActor* Find(const AActor* Actor);
+	FTrackedActor* Find(FTrackedActorHandle Handle);
+	FTrackedActorHandle FindHandle(const AActor* Actor) const;
+
+	/* Handle of the entry at a dense index, to keep referring to it once other entries are removed. */
+	FTrackedActorHandle GetHandle(int32 Index) const;
+
+	/* Dense index of a tracked actor, also its index in the crossing tracker. */
+	int32 IndexOf(const AActor* Actor) const;
+
+	bool Contains(const AActor* Actor) const { return ActorSlots.Contains(Actor); }
+	int32 Num() const { return Entries.Num(); }
+
+	FTrackedActor& operator[](const int32 Index) { return Entries[Index]; }
+	const FTrackedActor& operator[](const int32 Index) const { return Entries[Index]; }
+
+	FPortalCrossingTracker& GetCrossingTracker() { return CrossingTracker; }
+
+	TArray<FTrackedActor>::RangedForIteratorType begin() { return Entries.begin(); }
+	TArray<FTrackedActor>::RangedForIteratorType end() { return Entries.end(); }
+	TArray<FTrackedActor>::RangedForConstIteratorType begin() const { return Entries.begin(); }
+	TArray<FTrackedActor>::RangedForConstIteratorType end() const { return Entries.end(); }
+
+private:
+	void RemoveAt(int32 Index);
+
+	UPROPERTY()
+	TArray<FTrackedActor> Entries;
+
+	FPortalCrossingTracker CrossingTracker;
+
+	/* Dense index and generation of every slot, freed slots are reused with a new generation. */
+	TArray<int32> SlotIndices;
+	TArray<uint32> SlotGenerations;
+	TArray<int32> FreeSlots;
+
+	TMap<const AActor*, int32> ActorSlots;
+};
@@ -3,12 +3,12 @@
 
 #include "PDoor.h"
 
-#include "PDoorTrigger.h"
+#include "Portal/Subsystems/PSignalSubsystem.h"
 
 
-APDoor::APDoor() : bIsOpen(false)
+APDoor::APDoor()
 {
-	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bCanEverTick = false;
 	
 	RootComp = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
 	RootComp->SetupAttachment(RootComponent);
@@ -20,30 +20,45 @@ APDoor::APDoor() : bIsOpen(false)
 	RightDoorMesh->SetupAttachment(RootComp);
 }
 
-void APDoor::Tick(float DeltaTime)
+void APDoor::BeginPlay()
 {
-	Super::Tick(DeltaTime);
+	Super::BeginPlay();
 
-	if (ensureMsgf(Triggers.Num() > 0, TEXT("Door Triggers is empty.")) == false)
-		return;
-	
-	for (const APDoorTrigger* Trigger : Triggers)
+	ensureMsgf(Triggers.Num() > 0, TEXT("'%s' Door Triggers is empty."), *GetNameSafe(this));
+
+	RegisterSignalNode();
+}
+
+void APDoor::SetTriggers(const TArray<AActor*>& InTriggers)
+{
+	Triggers = TArray<TObjectPtr<AActor>>(InTriggers);
+
+	if (HasActorBegunPlay())
+		RegisterSignalNode();
+}
+
+void APDoor::RegisterSignalNode()
+{
+	// The door only hears from the network when all its triggers become active or one of them deactivates
+	if (UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>())
 	{
-		if (Trigger->IsActivated() == false)
-		{
-			if (bIsOpen)
-			{
-				bIsOpen = false;
-				CloseDoor();
-			}
-			
-			return;
-		}
+		const TArray<const UObject*> TriggerObjects(Triggers);
+		SignalSubsystem->AddNode(this, EPSignalLogic::And, TriggerObjects, FOnSignalChanged::CreateUObject(this, &APDoor::OnSignalChanged));
 	}
+}
 
-	if (bIsOpen)
-		return;
+void APDoor::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>())
+		SignalSubsystem->RemoveNode(this);
 
-	bIsOpen = true;
-	OpenDoor();
+	Super::EndPlay(EndPlayReason);
+}
+
+void APDoor::OnSignalChanged(const bool bIsActive)
+{
+	if (bIsActive)
+		OpenDoor();
+	else
+		CloseDoor();
 }
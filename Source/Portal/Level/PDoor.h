@@ -6,8 +6,7 @@
 #include "GameFramework/Actor.h"
 #include "PDoor.generated.h"
 
-class APDoorTrigger;
-
+/* Opens when every one of its triggers is active, driven by the signal network instead of ticking. */
 UCLASS()
 class PORTAL_API APDoor : public AActor
 {
@@ -16,9 +15,13 @@ class PORTAL_API APDoor : public AActor
 public:
 	APDoor();
 
-	virtual void Tick(float DeltaTime) override;
+	/* Replace the triggers of the door, registered again with the signal network if the door already began play. */
+	void SetTriggers(const TArray<AActor*>& InTriggers);
 
 protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable)
 	void OpenDoor();
 
@@ -26,6 +29,9 @@ protected:
 	void CloseDoor();
 
 private:
+	void RegisterSignalNode();
+	void OnSignalChanged(bool bIsActive);
+
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<USceneComponent> RootComp;
 	
@@ -35,8 +41,7 @@ private:
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<UStaticMeshComponent> RightDoorMesh;
 
+	/* Triggers, signal gates or any actor registered in the signal network. */
 	UPROPERTY(EditInstanceOnly, BlueprintReadOnly, Category = "Door", meta = (AllowPrivateAccess = "true"))
-	TArray<APDoorTrigger*> Triggers;
-	
-	bool bIsOpen;
+	TArray<TObjectPtr<AActor>> Triggers;
 };
@@ -4,10 +4,15 @@
 #include "PDoorTrigger.h"
 
 #include "Components/BoxComponent.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Portal/Subsystems/PSignalSubsystem.h"
 
 
-APDoorTrigger::APDoorTrigger() : bIsActivated(false)
+APDoorTrigger::APDoorTrigger() : bIsActivated(false), bActivateByMass(true), ActivationMass(20.0f), OccupantMass(0.0f)
 {
+	PrimaryActorTick.bCanEverTick = false;
+
 	BaseMesh = CreateDefaultSubobject<UStaticMeshComponent>(TEXT("Base"));
 	RootComponent = BaseMesh;
 	
@@ -18,3 +23,109 @@ APDoorTrigger::APDoorTrigger() : bIsActivated(false)
 	TriggerBox->SetupAttachment(TriggerMesh);
 }
 
+void APDoorTrigger::SetActivated(const bool bNewActivated)
+{
+	if (bActivateByMass)
+		return;
+
+	ApplyActivation(bNewActivated);
+}
+
+void APDoorTrigger::ApplyActivation(const bool bNewActivated)
+{
+	if (bIsActivated == bNewActivated)
+		return;
+
+	bIsActivated = bNewActivated;
+
+	if (UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>())
+		SignalSubsystem->SetSourceActive(this, bIsActivated);
+}
+
+void APDoorTrigger::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>())
+	{
+		SignalSubsystem->AddNode(this, EPSignalLogic::Source, {}, FOnSignalChanged());
+		SignalSubsystem->SetSourceActive(this, bIsActivated);
+	}
+
+	if (bActivateByMass == false)
+		return;
+
+	TriggerBox->OnComponentBeginOverlap.AddDynamic(this, &APDoorTrigger::OnTriggerBoxOverlapStart);
+	TriggerBox->OnComponentEndOverlap.AddDynamic(this, &APDoorTrigger::OnTriggerBoxOverlapEnd);
+
+	// Bodies already on the plate don't start an overlap
+	TArray<UPrimitiveComponent*> OverlappingComponents;
+	TriggerBox->GetOverlappingComponents(OverlappingComponents);
+	for (UPrimitiveComponent* Component : OverlappingComponents)
+		AddOccupant(Component);
+
+	UpdateActivation();
+}
+
+void APDoorTrigger::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>())
+		SignalSubsystem->RemoveNode(this);
+
+	Occupants.Reset();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void APDoorTrigger::OnTriggerBoxOverlapStart(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult)
+{
+	AddOccupant(OtherComp);
+	UpdateActivation();
+}
+
+void APDoorTrigger::OnTriggerBoxOverlapEnd(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex)
+{
+	RemoveOccupant(OtherComp);
+	UpdateActivation();
+}
+
+void APDoorTrigger::AddOccupant(UPrimitiveComponent* Component)
+{
+	if (Component == nullptr || Occupants.Contains(Component))
+		return;
+
+	const float Mass = GetOccupantMass(Component);
+	if (Mass <= 0.0f)
+		return;
+
+	Occupants.Add(Component, Mass);
+	OccupantMass += Mass;
+}
+
+void APDoorTrigger::RemoveOccupant(const UPrimitiveComponent* Component)
+{
+	float Mass;
+	if (Occupants.RemoveAndCopyValue(Component, Mass) == false)
+		return;
+
+	// Reset on the last occupant so rounding errors don't pile up
+	OccupantMass = Occupants.Num() > 0 ? FMath::Max(OccupantMass - Mass, 0.0f) : 0.0f;
+}
+
+void APDoorTrigger::UpdateActivation()
+{
+	ApplyActivation(Occupants.Num() > 0 && OccupantMass >= ActivationMass);
+}
+
+float APDoorTrigger::GetOccupantMass(const UPrimitiveComponent* Component)
+{
+	if (Component->IsSimulatingPhysics())
+		return Component->GetMass();
+
+	// Characters move kinematically, their movement component holds their mass
+	const ACharacter* Character = Cast<ACharacter>(Component->GetOwner());
+	if (Character && Component == Character->GetRootComponent())
+		return Character->GetCharacterMovement()->Mass;
+
+	return 0.0f;
+}
@@ -8,6 +8,10 @@
 
 class UBoxComponent;
 
+/*
+ Pressure plate of the signal network. The bodies overlapping the trigger box are kept in an occupant set with their summed mass,
+ updated on overlap begin and end only, and the plate is activated while that mass reaches the activation mass.
+ */
 UCLASS()
 class PORTAL_API APDoorTrigger : public AActor
 {
@@ -18,7 +22,34 @@ public:
 
 	bool IsActivated() const { return bIsActivated; }
 
+	float GetOccupantMass() const { return OccupantMass; }
+
+	/*
+	 Activate or deactivate the trigger and notify the signal network.
+	 Ignored while bActivateByMass is set, so the trigger box overlap nodes of BP_Trigger can't override the mass of the occupants.
+	 */
+	UFUNCTION(BlueprintSetter)
+	void SetActivated(bool bNewActivated);
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	UFUNCTION()
+	void OnTriggerBoxOverlapStart(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex, bool bFromSweep, const FHitResult& SweepResult);
+
+	UFUNCTION()
+	void OnTriggerBoxOverlapEnd(UPrimitiveComponent* OverlappedComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, int32 OtherBodyIndex);
+
 private:
+	void AddOccupant(UPrimitiveComponent* Component);
+	void RemoveOccupant(const UPrimitiveComponent* Component);
+	void UpdateActivation();
+	void ApplyActivation(bool bNewActivated);
+
+	/* Mass a body weighs on the plate, zero for bodies that can't press it like kinematic portal copies. */
+	static float GetOccupantMass(const UPrimitiveComponent* Component);
+
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<UStaticMeshComponent> TriggerMesh;
 
@@ -28,6 +59,20 @@ private:
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<UBoxComponent> TriggerBox;
 
-	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, meta = (AllowPrivateAccess = "true"))
+	UPROPERTY(VisibleAnywhere, BlueprintReadWrite, BlueprintSetter = SetActivated, meta = (AllowPrivateAccess = "true"))
 	bool bIsActivated;
+
+	/* Activate from the mass of the occupants, off for triggers driven by gameplay through SetActivated. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Trigger", meta = (AllowPrivateAccess = "true"))
+	bool bActivateByMass;
+
+	/* Summed mass in kilograms the occupants need to activate the plate. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Trigger", meta = (AllowPrivateAccess = "true", ClampMin = "0", EditCondition = "bActivateByMass"))
+	float ActivationMass;
+
+	UPROPERTY(VisibleInstanceOnly, BlueprintReadOnly, Category = "Trigger", meta = (AllowPrivateAccess = "true"))
+	float OccupantMass;
+
+	/* Overlapping bodies with the mass they added. */
+	TMap<TWeakObjectPtr<const UPrimitiveComponent>, float> Occupants;
 };
@@ -3,6 +3,9 @@
 
 #include "PGhostPortalBorder.h"
 
+#include "StaticMeshResources.h"
+#include "Engine/StaticMesh.h"
+
 APGhostPortalBorder::APGhostPortalBorder()
 {
 	RootComponent = CreateDefaultSubobject<USceneComponent>("SceneRoot");
@@ -16,18 +19,131 @@ void APGhostPortalBorder::BeginPlay()
 {
 	Super::BeginPlay();
 
-	if (const TObjectPtr<UStaticMesh> Mesh = MeshComp->GetStaticMesh())
+	if (const UStaticMesh* Mesh = MeshComp->GetStaticMesh())
+		HullVertices = FindOrBuildHull(Mesh);
+}
+
+FVector2D APGhostPortalBorder::GetHalfExtentsOnWall(const FTransform& WallTransform) const
+{
+	if (ensureMsgf(HullVertices.Num() > 0, TEXT("Ghost border hull is empty.")) == false)
+		return FVector2D::ZeroVector;
+
+	// Only directions matter for the size, the hull is brought into wall space without its translation
+	const FQuat RelativeQuat = MeshComp->GetRelativeRotation().Quaternion();
+	const FTransform& ActorTransform = GetActorTransform();
+
+	FVector2D Min(UE_BIG_NUMBER, UE_BIG_NUMBER);
+	FVector2D Max(-UE_BIG_NUMBER, -UE_BIG_NUMBER);
+	for (const FVector& Vertex : HullVertices)
+	{
+		const FVector WallVertex = WallTransform.InverseTransformVector(ActorTransform.TransformVector(RelativeQuat.RotateVector(Vertex)));
+
+		Min.X = FMath::Min(Min.X, WallVertex.Y);
+		Min.Y = FMath::Min(Min.Y, WallVertex.Z);
+		Max.X = FMath::Max(Max.X, WallVertex.Y);
+		Max.Y = FMath::Max(Max.Y, WallVertex.Z);
+	}
+
+	return (Max - Min) * 0.5;
+}
+
+const TArray<FVector>& APGhostPortalBorder::FindOrBuildHull(const UStaticMesh* Mesh)
+{
+	static TMap<TObjectKey<UStaticMesh>, TArray<FVector>> HullCache;
+
+	if (const TArray<FVector>* CachedHull = HullCache.Find(Mesh))
+		return *CachedHull;
+
+	TArray<FVector>& Hull = HullCache.Add(Mesh);
+
+	const FStaticMeshRenderData* RenderData = Mesh->GetRenderData();
+	if (RenderData == nullptr || RenderData->LODResources.Num() == 0 || RenderData->LODResources[0].Sections.Num() == 0)
+		return Hull;
+
+	// Each vertex once, instead of once per triangle through the index buffer
+	const FStaticMeshLODResources& LOD = RenderData->LODResources[0];
+	const FStaticMeshSection& Section = LOD.Sections[0];
+
+	FBox Bounds(ForceInit);
+	for (uint32 i = Section.MinVertexIndex; i <= Section.MaxVertexIndex; i++)
+		Bounds += FVector(LOD.VertexBuffers.PositionVertexBuffer.VertexPosition(i));
+
+	// The flattest axis is the depth of the border
+	const FVector Size = Bounds.GetSize();
+	const int32 DepthAxis = Size.X <= Size.Y ? (Size.X <= Size.Z ? 0 : 2) : (Size.Y <= Size.Z ? 1 : 2);
+	const int32 UAxis = (DepthAxis + 1) % 3;
+	const int32 VAxis = (DepthAxis + 2) % 3;
+
+	TArray<FVector2D> Points;
+	Points.Reserve(Section.MaxVertexIndex - Section.MinVertexIndex + 1);
+	for (uint32 i = Section.MinVertexIndex; i <= Section.MaxVertexIndex; i++)
 	{
-		const FStaticMeshLODResources& LOD = Mesh->GetRenderData()->LODResources[0];
+		const FVector Position = FVector(LOD.VertexBuffers.PositionVertexBuffer.VertexPosition(i));
+		Points.Add(FVector2D(Position[UAxis], Position[VAxis]));
+	}
 
-		const FStaticMeshSection& Section = LOD.Sections[0];
-		const uint32 OnePastLastIndex = Section.FirstIndex + Section.NumTriangles * 3;
-		FIndexArrayView Indices = LOD.IndexBuffer.GetArrayView();
+	TArray<FVector2D> Hull2D;
+	BuildConvexHull(Points, Hull2D);
 
-		for (uint32 i = Section.FirstIndex; i < OnePastLastIndex; i++)
+	const bool bHasDepth = Size[DepthAxis] > UE_KINDA_SMALL_NUMBER;
+	for (const FVector2D& Point : Hull2D)
+	{
+		FVector Vertex;
+		Vertex[UAxis] = Point.X;
+		Vertex[VAxis] = Point.Y;
+		Vertex[DepthAxis] = Bounds.Min[DepthAxis];
+		Hull.Add(Vertex);
+
+		if (bHasDepth)
 		{
-			const uint32 MeshVertIndex = Indices[i];
-			Vertices.Add(FVector(LOD.VertexBuffers.PositionVertexBuffer.VertexPosition(MeshVertIndex)));
+			Vertex[DepthAxis] = Bounds.Max[DepthAxis];
+			Hull.Add(Vertex);
 		}
 	}
+
+	return Hull;
+}
+
+void APGhostPortalBorder::BuildConvexHull(TArray<FVector2D>& Points, TArray<FVector2D>& OutHull)
+{
+	OutHull.Reset();
+
+	Points.Sort([](const FVector2D& A, const FVector2D& B)
+	{
+		return A.X < B.X || (A.X == B.X && A.Y < B.Y);
+	});
+
+	if (Points.Num() < 3)
+	{
+		OutHull = Points;
+		return;
+	}
+
+	// Lower then upper chain, only counter-clockwise turns are kept which also drops duplicated and collinear points
+	auto Cross = [](const FVector2D& O, const FVector2D& A, const FVector2D& B)
+	{
+		return (A.X - O.X) * (B.Y - O.Y) - (A.Y - O.Y) * (B.X - O.X);
+	};
+
+	OutHull.SetNum(Points.Num() * 2);
+	int32 Count = 0;
+	for (int32 i = 0; i < Points.Num(); i++)
+	{
+		while (Count >= 2 && Cross(OutHull[Count - 2], OutHull[Count - 1], Points[i]) <= 0.0)
+			Count--;
+
+		OutHull[Count++] = Points[i];
+	}
+
+	const int32 LowerCount = Count + 1;
+	for (int32 i = Points.Num() - 2; i >= 0; i--)
+	{
+		while (Count >= LowerCount && Cross(OutHull[Count - 2], OutHull[Count - 1], Points[i]) <= 0.0)
+			Count--;
+
+		OutHull[Count++] = Points[i];
+	}
+
+	// The last point is the first one again
+	OutHull.SetNum(Count - 1);
 }
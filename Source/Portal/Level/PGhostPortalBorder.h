@@ -17,14 +17,31 @@ class PORTAL_API APGhostPortalBorder : public AActor
 public:
 	APGhostPortalBorder();
 
-	TArray<FVector> GetVertices() const { return Vertices; }
+	/* Vertices of the convex hull of the border mesh, in mesh space. */
+	const TArray<FVector>& GetHullVertices() const { return HullVertices; }
+
+	/* Use this hull instead of the one of the mesh, read on begin play. */
+	void SetHullVertices(const TArray<FVector>& InHullVertices) { HullVertices = InHullVertices; }
 	FRotator GetRelativeRotation() const { return MeshComp->GetRelativeRotation(); }
 
+	/* Half width and half height of the border along the Y and Z axes of a wall, wherever the border currently stands. */
+	FVector2D GetHalfExtentsOnWall(const FTransform& WallTransform) const;
+
 protected:
 	virtual void BeginPlay() override;
 
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<UStaticMeshComponent> MeshComp;
 
-	TArray<FVector> Vertices;
+	TArray<FVector> HullVertices;
+
+private:
+	/*
+	 Hull of a border mesh, built from its first section the first time the mesh is used and shared by every border using it.
+	 The mesh is flat, the 2D hull is built in the plane of its two largest axes then extruded over its depth if it has any.
+	 */
+	static const TArray<FVector>& FindOrBuildHull(const UStaticMesh* Mesh);
+
+	/* Monotone chain convex hull, points are sorted in place. */
+	static void BuildConvexHull(TArray<FVector2D>& Points, TArray<FVector2D>& OutHull);
 };
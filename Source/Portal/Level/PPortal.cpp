@@ -5,20 +5,36 @@
 
 #include "PPortalWall.h"
 #include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
 #include "Components/BoxComponent.h"
 #include "Components/SceneCaptureComponent2D.h"
+#include "Engine/OverlapResult.h"
+#include "Engine/TextureRenderTarget2D.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Kismet/KismetRenderingLibrary.h"
+#include "SceneManagement.h"
+#include "Portal/Portal.h"
 #include "Portal/PCharacter.h"
 #include "Portal/PPlayerController.h"
 #include "Portal/Helpers/PPortalHelper.h"
+#include "Portal/Subsystems/PPortalSubsystem.h"
 
 DEFINE_LOG_CATEGORY(LogPortal);
 
-APPortal::APPortal() : CurrentWall(nullptr), bPortalLeft(true), PortalRenderScale(1.0f), TargetPortal(nullptr), bInitialized(false), ActorsBeingTracked(0)
+extern TAutoConsoleVariable<int32> CVarPortalRecursionDepth;
+extern TAutoConsoleVariable<float> CVarPortalRecursionBudget;
+extern TAutoConsoleVariable<int32> CVarPortalRecursionFallback;
+
+/* Pool level of the black texture shown past the deepest rendered recursion level. */
+static constexpr int32 FallbackRecursionLevel = -1;
+
+APPortal::APPortal() : CurrentWall(nullptr), bPortalLeft(true), PortalRenderScale(1.0f), bSkipHiddenPortalCapture(true), bUseDynamicResolution(true), MinDynamicResolutionScale(0.25f),
+                       DynamicResolutionBuckets(4), CoverageResolutionScale(2.0f), bUseSweptCrossing(true), MaxSweptCrossingSpeed(6000.0f), bUseInstancedCopies(true),
+                       TargetPortal(nullptr), CurrentResolutionBucket(0), FramesBelowResolutionBucket(0), AverageCaptureTimeMs(0.0), ScreenCoverage(1.0f),
+                       PortalTransformVersion(1), CachedOriginTransformVersion(0), CachedTargetTransformVersion(0), bInitialized(false)
 {
-	PrimaryActorTick.bCanEverTick = true;
-	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+	// Rendering is driven by the portal subsystem, the actor itself never ticks
+	PrimaryActorTick.bCanEverTick = false;
 
 	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("RootComponent"));
 
@@ -34,16 +50,6 @@ APPortal::APPortal() : CurrentWall(nullptr), bPortalLeft(true), PortalRenderScal
 	PortalBox->SetUseCCD(true);
 	PortalBox->SetupAttachment(RootComponent);
 
-	SceneCapture = CreateDefaultSubobject<USceneCaptureComponent2D>(TEXT("SceneCapture"));
-	SceneCapture->SetupAttachment(RootComponent);
-	SceneCapture->bEnableClipPlane = true;
-	SceneCapture->bUseCustomProjectionMatrix = false;
-	SceneCapture->bCaptureEveryFrame = false;
-	SceneCapture->bCaptureOnMovement = false;
-	SceneCapture->LODDistanceFactor = 3;
-	SceneCapture->TextureTarget = nullptr;
-	SceneCapture->CaptureSource = SCS_SceneColorHDR;
-
 	// Add post-physics ticking to this actor
 	PhysicsTick.bCanEverTick = true;
 	PhysicsTick.Target = this;
@@ -54,6 +60,11 @@ void APPortal::OnConstruction(const FTransform& Transform)
 {
 	Super::OnConstruction(Transform);
 
+	// Blueprints saved while portals owned their capture still serialize that component, it would keep capturing on top of the portal subsystem
+	TInlineComponentArray<USceneCaptureComponent2D*> StaleCaptures(this);
+	for (USceneCaptureComponent2D* StaleCapture : StaleCaptures)
+		StaleCapture->DestroyComponent();
+
 	if (PortalBorderMesh != nullptr)
 	{
 		if (bPortalLeft)
@@ -76,6 +87,14 @@ void APPortal::BeginPlay()
 	if (Character != nullptr)
 		PlayerCamera = Character->GetFirstPersonCameraComponent();
 
+	// Invalidate the cached portal space transforms whenever the portal moves
+	PortalMesh->TransformUpdated.AddUObject(this, &APPortal::OnPortalMeshTransformUpdated);
+
+	RegisterWithPortalSubsystem();
+
+	if (InitialLinkedPortal != nullptr)
+		PortalSubsystem->LinkPortals(this, InitialLinkedPortal);
+
 	CreatePortalTexture();
 
 	// Register the secondary post-physics tick function in the world on level start
@@ -100,29 +119,59 @@ void APPortal::BeginPlay()
 	{
 		// For each found overlapping actor on begin play check if it can move and started overlapping in-front of the portal, if so, track it until it ends its overlap.
 		for (AActor* OverlappedActor : OverlappingActors)
-		{
-			const USceneComponent* OverlappedRootComponent = OverlappedActor->GetRootComponent();
-			if (OverlappedRootComponent && OverlappedRootComponent->IsSimulatingPhysics() || OverlappedActor->IsA(APCharacter::StaticClass()))
-			{
-				// Ensure that the item entering the portal is in-front.
-				if (TrackedActors.Contains(OverlappedActor) == false && IsPointInFrontOfPortal(OverlappedRootComponent->GetComponentLocation()))
-				{
-					AddTrackedActor(OverlappedActor);
-				}
-			}
-		}
+			TryTrackEnteringActor(OverlappedActor);
 	}
+}
+
+void APPortal::PlaceOnWall(APPortalWall* Wall, const FVector2D& PortalExtents, const bool bIsFloorPortal)
+{
+	CurrentWall = Wall;
+	Extents = PortalExtents;
+	UpdatePortalBorderCollision(bIsFloorPortal);
+	OnPortalSpawned();
+}
 
-	PrimaryActorTick.SetTickFunctionEnable(true);
+void APPortal::RegisterWithPortalSubsystem()
+{
+	PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>();
+	check(PortalSubsystem);
+	PortalSubsystem->RegisterPortal(this);
 }
 
-void APPortal::Tick(float DeltaSeconds)
+void APPortal::SetUseInstancedCopies(const bool bInUseInstancedCopies)
 {
-	Super::Tick(DeltaSeconds);
+	if (ensureMsgf(TrackedActors.Num() == 0, TEXT("'%s' Copies can't change type while actors are tracked."), *GetNameSafe(this)) == false)
+		return;
+
+	bUseInstancedCopies = bInUseInstancedCopies;
+}
+
+void APPortal::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (PortalSubsystem != nullptr)
+		PortalSubsystem->UnregisterPortal(this);
+
+	if (PhysicsTick.IsTickFunctionRegistered())
+		PhysicsTick.UnRegisterTickFunction();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void APPortal::TickPortalView()
+{
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalTickView);
 
 	if (bInitialized == false)
 		return;
 
+	// Don't pay for a clear and a capture nobody will see
+	if (bSkipHiddenPortalCapture && IsVisibleToPlayer() == false)
+		return;
+
+	int32 ViewportX, ViewportY;
+	PlayerController->GetViewportSize(ViewportX, ViewportY);
+	ScreenCoverage = ComputeScreenCoverage(ViewportX, ViewportY);
+
 	ClearPortalView();
 
 	if (TargetPortal == nullptr)
@@ -131,24 +180,129 @@ void APPortal::Tick(float DeltaSeconds)
 	UpdatePortalView();
 }
 
+FMatrix APPortal::GetPlayerViewProjectionMatrix() const
+{
+	const FMinimalViewInfo& CameraView = PlayerController->PlayerCameraManager->GetCameraCacheView();
+	return UPPortalHelper::MakeViewMatrix(CameraView.Location, CameraView.Rotation) * PlayerController->GetCameraProjectionMatrix();
+}
+
 void APPortal::PostPhysicsTick(float DeltaTime)
 {
-	UpdateTrackedActors();
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalPostPhysicsTick);
+	INC_DWORD_STAT_BY(STAT_PortalTrackedActors, TrackedActors.Num());
+
+	UpdateTrackedActors(DeltaTime);
+
+	// Look for what will go through before the next step, after this step's crossings have been handled
+	if (bUseSweptCrossing && TargetPortal != nullptr)
+		TrackIncomingFastMovers(DeltaTime);
 }
 
 void APPortal::OnPortalBoxOverlapStart(UPrimitiveComponent*, AActor* OverlappedActor, UPrimitiveComponent*, int32, bool, const FHitResult&)
+{
+	TryTrackEnteringActor(OverlappedActor);
+}
+
+void APPortal::TryTrackEnteringActor(AActor* OverlappedActor)
 {
 	const USceneComponent* OverlappedRootComponent = OverlappedActor->GetRootComponent();
-	if (OverlappedRootComponent && OverlappedRootComponent->IsSimulatingPhysics() || OverlappedActor->IsA(APCharacter::StaticClass()))
+	if ((OverlappedRootComponent && OverlappedRootComponent->IsSimulatingPhysics() || OverlappedActor->IsA(APCharacter::StaticClass())) == false)
+		return;
+
+	// Already picked up as a fast mover, it's now a regular tracked actor
+	if (FTrackedActor* Tracked = TrackedActors.Find(OverlappedActor))
 	{
-		// Ensure that the item entering the portal is in-front.
-		if (TrackedActors.Contains(OverlappedActor) == false && IsPointInFrontOfPortal(OverlappedRootComponent->GetComponentLocation()))
+		Tracked->bSpeculative = false;
+		Tracked->SpeculativeProfileName = NAME_None;
+		return;
+	}
+
+	// Ensure that the item entering the portal is in-front.
+	if (IsPointInFrontOfPortal(OverlappedRootComponent->GetComponentLocation()))
+	{
+		AddTrackedActor(OverlappedActor);
+		return;
+	}
+
+	if (bUseSweptCrossing == false)
+		return;
+
+	// A fast mover can enter the box and go past the plane in the same step, check where it was at the start of the step
+	const FVector TrackedPoint = GetTrackedPoint(OverlappedActor);
+	const FVector LastTrackedPoint = TrackedPoint - OverlappedActor->GetVelocity() * GetWorld()->GetDeltaSeconds();
+	if (IsPointInFrontOfPortal(LastTrackedPoint) == false || IsCrossingPortalOpening(LastTrackedPoint, TrackedPoint) == false)
+		return;
+
+	AddTrackedActor(OverlappedActor);
+
+	// The crossing is then found by the next update, as if it had been tracked since the last step
+	const int32 Index = TrackedActors.IndexOf(OverlappedActor);
+	if (Index != INDEX_NONE)
+		TrackedActors.GetCrossingTracker().SetLastLocation(Index, LastTrackedPoint);
+}
+
+void APPortal::TrackIncomingFastMovers(float DeltaTime)
+{
+	if (MaxSweptCrossingSpeed <= 0.0f)
+		return;
+
+	// Grow the portal box forward by the distance the fastest accepted actor covers in one step
+	const float Reach = MaxSweptCrossingSpeed * DeltaTime;
+	FVector QueryExtent = PortalBox->GetScaledBoxExtent();
+	QueryExtent.X += Reach * 0.5f;
+	const FVector QueryCenter = PortalBox->GetComponentLocation() + PortalMesh->GetForwardVector() * (Reach * 0.5f);
+
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_CompanionCube);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+	ObjectParams.AddObjectTypesToQuery(ECC_Pawn);
+
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(PortalFastMovers), false, this);
+
+	TArray<FOverlapResult> Overlaps;
+	if (GetWorld()->OverlapMultiByObjectType(Overlaps, QueryCenter, PortalBox->GetComponentQuat(), ObjectParams, FCollisionShape::MakeBox(QueryExtent), QueryParams) == false)
+		return;
+
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		AActor* Actor = Overlap.GetActor();
+		if (Actor == nullptr || TrackedActors.Contains(Actor))
+			continue;
+
+		const USceneComponent* ActorRootComponent = Actor->GetRootComponent();
+		if ((ActorRootComponent && ActorRootComponent->IsSimulatingPhysics() || Actor->IsA<APCharacter>()) == false)
+			continue;
+
+		// Only the ones going through the opening before the next update, the others are picked up by the portal box
+		const FVector TrackedPoint = GetTrackedPoint(Actor);
+		const FVector NextTrackedPoint = TrackedPoint + Actor->GetVelocity() * DeltaTime + GetTrackedGravity(Actor) * (0.5f * DeltaTime * DeltaTime);
+		if (IsPointInFrontOfPortal(TrackedPoint) == false || IsCrossingPortalOpening(TrackedPoint, NextTrackedPoint) == false)
+			continue;
+
+		AddTrackedActor(Actor);
+
+		FTrackedActor* Tracked = TrackedActors.Find(Actor);
+		if (Tracked == nullptr)
+			continue;
+
+		Tracked->bSpeculative = true;
+
+		// The next step runs before the next update, it must already go through the wall instead of bouncing off it
+		UPrimitiveComponent* Comp = Cast<UPrimitiveComponent>(ActorRootComponent);
+		const FName ProfileName = GetPassThroughProfileName(Actor);
+		if (Comp != nullptr && Comp->GetCollisionProfileName() != ProfileName)
 		{
-			AddTrackedActor(OverlappedActor);
+			Tracked->SpeculativeProfileName = Comp->GetCollisionProfileName();
+			Comp->SetCollisionProfileName(ProfileName);
 		}
 	}
 }
 
+FName APPortal::GetPassThroughProfileName(const AActor* Actor)
+{
+	return Actor->IsA<APCharacter>() ? FName("PortalPawn") : FName("PortalCube");
+}
+
 void APPortal::OnPortalBoxOverlapEnd(UPrimitiveComponent*, AActor* OverlappedActor, UPrimitiveComponent*, int32)
 {
 	if (TrackedActors.Contains(OverlappedActor))
@@ -160,25 +314,13 @@ void APPortal::OnPortalBoxOverlapEnd(UPrimitiveComponent*, AActor* OverlappedAct
 void APPortal::OnPortalMeshOverlapStart(UPrimitiveComponent*, AActor* OverlappedActor, UPrimitiveComponent*, int32, bool, const FHitResult&)
 {
 	// Show the copied actor once it's overlapping with the portal itself.
-	if (TrackedActors.Contains(OverlappedActor))
-	{
-		if (const AActor* Copy = TrackedActors.FindRef(OverlappedActor).TrackedCopy)
-		{
-			SetCopyVisibility(Copy, true);
-		}
-	}
+	SetTrackedCopyVisibility(OverlappedActor, true);
 }
 
 void APPortal::OnPortalMeshOverlapEnd(UPrimitiveComponent*, AActor* OverlappedActor, UPrimitiveComponent*, int32)
 {
 	// Hide the copied actor once it's stopped overlapping with the portal by exiting it and not passing through it.
-	if (TrackedActors.Contains(OverlappedActor))
-	{
-		if (const AActor* Copy = TrackedActors.FindRef(OverlappedActor).TrackedCopy)
-		{
-			SetCopyVisibility(Copy, false);
-		}
-	}
+	SetTrackedCopyVisibility(OverlappedActor, false);
 }
 
 void APPortal::Init(const bool bIsLeftPortal)
@@ -190,30 +332,99 @@ void APPortal::CreatePortalTexture()
 {
 	int32 ViewportX, ViewportY;
 	PlayerController->GetViewportSize(ViewportX, ViewportY);
-	ViewportX *= PortalRenderScale;
-	ViewportY *= PortalRenderScale;
 
-	RenderTarget = NewObject<UTextureRenderTarget2D>(this, UTextureRenderTarget2D::StaticClass(), FName("PortalRenderTarget"));
-	check(RenderTarget);
+	PortalMaterial = PortalMesh->CreateDynamicMaterialInstance(0, PortalMaterialInstance);
 
-	RenderTarget->RenderTargetFormat = RTF_RGBA16f;
-	RenderTarget->SizeX = ViewportX;
-	RenderTarget->SizeY = ViewportY;
-	RenderTarget->ClearColor = FLinearColor::Black;
-	RenderTarget->TargetGamma = 2.2f;
-	RenderTarget->bNeedsTwoCopies = false;
-	RenderTarget->bCanCreateUAV = false;
+	// Start at full resolution, the bucket is refined on the first view update
+	CurrentResolutionBucket = 0;
+	UpdateRenderTarget(ViewportX, ViewportY);
+}
 
-	// Not needed since the texture is displayed on screen directly
-	RenderTarget->bAutoGenerateMips = false;
+void APPortal::UpdateRenderTarget(const int32 ViewportX, const int32 ViewportY)
+{
+	if (bUseDynamicResolution)
+		CurrentResolutionBucket = SelectResolutionBucket(ScreenCoverage);
 
-	// This forces the engine to create the render target with the parameters we defined just above
-	RenderTarget->UpdateResource();
+	const float Scale = PortalRenderScale * GetResolutionBucketScale(CurrentResolutionBucket);
+	const int32 SizeX = FMath::Max(1, FMath::RoundToInt(ViewportX * Scale));
+	const int32 SizeY = FMath::Max(1, FMath::RoundToInt(ViewportY * Scale));
 
-	PortalMaterial = PortalMesh->CreateDynamicMaterialInstance(0, PortalMaterialInstance);
-	PortalMaterial->SetTextureParameterValue(FName("RenderTarget"), RenderTarget);
+	UTextureRenderTarget2D* BucketTarget = PortalSubsystem->GetRenderTargetPool().FindOrCreate(PortalSubsystem, this, CurrentResolutionBucket, 0, SizeX, SizeY);
+	if (BucketTarget == RenderTarget)
+		return;
+
+	RenderTarget = BucketTarget;
+
+	if (PortalMaterial != nullptr)
+		PortalMaterial->SetTextureParameterValue(FName("RenderTarget"), RenderTarget);
+}
+
+float APPortal::ComputeScreenCoverage(const int32 ViewportX, const int32 ViewportY) const
+{
+	if (ViewportX <= 0 || ViewportY <= 0)
+		return 1.0f;
+
+	const FBoxSphereBounds& Bounds = PortalMesh->Bounds;
+	const FVector Min = Bounds.Origin - Bounds.BoxExtent;
+	const FVector Max = Bounds.Origin + Bounds.BoxExtent;
+
+	FVector2D ScreenMin(TNumericLimits<float>::Max());
+	FVector2D ScreenMax(TNumericLimits<float>::Lowest());
+	for (int32 i = 0; i < 8; i++)
+	{
+		const FVector Corner((i & 1) ? Max.X : Min.X, (i & 2) ? Max.Y : Min.Y, (i & 4) ? Max.Z : Min.Z);
+
+		// A corner behind the camera means we are very close to the portal, render it at full resolution
+		FVector2D ScreenPosition;
+		if (PlayerController->ProjectWorldLocationToScreen(Corner, ScreenPosition) == false)
+			return 1.0f;
+
+		ScreenMin = FVector2D::Min(ScreenMin, ScreenPosition);
+		ScreenMax = FVector2D::Max(ScreenMax, ScreenPosition);
+	}
+
+	// Only the visible part of the bounds matters
+	ScreenMin = FVector2D::Max(ScreenMin, FVector2D::ZeroVector);
+	ScreenMax = FVector2D::Min(ScreenMax, FVector2D(ViewportX, ViewportY));
 
-	SceneCapture->TextureTarget = RenderTarget;
+	const float CoverageX = static_cast<float>(FMath::Max(ScreenMax.X - ScreenMin.X, 0.0) / ViewportX);
+	const float CoverageY = static_cast<float>(FMath::Max(ScreenMax.Y - ScreenMin.Y, 0.0) / ViewportY);
+
+	return FMath::Max(CoverageX, CoverageY);
+}
+
+int32 APPortal::SelectResolutionBucket(const float Coverage)
+{
+	// Number of frames the portal must need a smaller bucket before we actually switch, avoids flickering between sizes
+	constexpr int32 DownscaleDelayFrames = 15;
+
+	const float RequiredScale = FMath::Clamp(Coverage * CoverageResolutionScale, MinDynamicResolutionScale, 1.0f);
+
+	// Smallest bucket that still satisfies the required scale, bucket 0 being full resolution
+	int32 Bucket = 0;
+	while (Bucket + 1 < DynamicResolutionBuckets && GetResolutionBucketScale(Bucket + 1) >= RequiredScale)
+		Bucket++;
+
+	if (Bucket <= CurrentResolutionBucket)
+	{
+		FramesBelowResolutionBucket = 0;
+		return Bucket;
+	}
+
+	if (++FramesBelowResolutionBucket < DownscaleDelayFrames)
+		return CurrentResolutionBucket;
+
+	FramesBelowResolutionBucket = 0;
+	return Bucket;
+}
+
+float APPortal::GetResolutionBucketScale(const int32 Bucket) const
+{
+	if (DynamicResolutionBuckets <= 1)
+		return 1.0f;
+
+	const float Alpha = static_cast<float>(Bucket) / (DynamicResolutionBuckets - 1);
+	return FMath::Lerp(1.0f, MinDynamicResolutionScale, Alpha);
 }
 
 void APPortal::LinkPortal(APPortal* OtherPortal)
@@ -228,7 +439,52 @@ void APPortal::LinkPortal(APPortal* OtherPortal)
 	}
 
 	TargetPortal = OtherPortal;
+	CachedOriginTransformVersion = 0;
 	PortalMesh->SetMaterial(0, PortalMaterial);
+
+	if (PortalSubsystem != nullptr)
+		PortalSubsystem->MarkPhysicsInputDirty();
+}
+
+void APPortal::UnlinkPortal()
+{
+	if (TargetPortal == nullptr)
+		return;
+
+	TargetPortal = nullptr;
+	PortalMesh->SetMaterial(0, DefaultPortalMaterial);
+
+	if (PortalSubsystem != nullptr)
+		PortalSubsystem->MarkPhysicsInputDirty();
+}
+
+const FTransform& APPortal::GetPortalSpaceTransform()
+{
+	check(TargetPortal);
+
+	if (CachedOriginTransformVersion != PortalTransformVersion || CachedTargetTransformVersion != TargetPortal->PortalTransformVersion)
+	{
+		CachedPortalSpaceTransform = UPPortalHelper::MakePortalSpaceTransform(PortalMesh, TargetPortal->PortalMesh);
+		CachedOriginTransformVersion = PortalTransformVersion;
+		CachedTargetTransformVersion = TargetPortal->PortalTransformVersion;
+	}
+
+	return CachedPortalSpaceTransform;
+}
+
+void APPortal::OnPortalMeshTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	PortalTransformVersion++;
+
+	// Never wrap back to the invalid cache version
+	if (PortalTransformVersion == 0)
+		PortalTransformVersion = 1;
+
+	if (PortalSubsystem != nullptr)
+	{
+		PortalSubsystem->UpdatePortalCell(this);
+		PortalSubsystem->MarkPhysicsInputDirty();
+	}
 }
 
 bool APPortal::IsPointInFrontOfPortal(const FVector& Point) const
@@ -240,6 +496,112 @@ bool APPortal::IsPointInFrontOfPortal(const FVector& Point) const
 	return PortalDot >= 0.0f;
 }
 
+bool APPortal::IsVisibleToPlayer() const
+{
+	if (PlayerController == nullptr || PlayerController->PlayerCameraManager == nullptr)
+		return true;
+
+	// The camera can sit right on the portal plane while the player goes through it, always render in that case
+	if (TrackedActors.Contains(PlayerController->GetPawn()))
+		return true;
+
+	// The portal surface can only be seen from the front
+	if (IsPointInFrontOfPortal(PlayerController->PlayerCameraManager->GetCameraCacheView().Location) == false)
+		return false;
+
+	// Frustum test of the portal mesh bounds
+	FConvexVolume ViewFrustum;
+	GetViewFrustumBounds(ViewFrustum, GetPlayerViewProjectionMatrix(), false);
+
+	const FBoxSphereBounds& Bounds = PortalMesh->Bounds;
+	if (ViewFrustum.IntersectBox(Bounds.Origin, Bounds.BoxExtent) == false)
+		return false;
+
+	// Occlusion, the renderer only updates the on screen render time of primitives that passed last frame's occlusion queries
+	const UWorld* World = GetWorld();
+	const float OcclusionTolerance = FMath::Max(0.1f, World->GetDeltaSeconds() * 2.0f);
+	return World->TimeSince(PortalMesh->GetLastRenderTimeOnScreen()) <= OcclusionTolerance;
+}
+
+bool APPortal::IsCrossingPortalOpening(const FVector& StartPoint, const FVector& EndPoint) const
+{
+	FVector IntersectionPoint;
+	return IsPointCrossingPortal(StartPoint, EndPoint, IntersectionPoint) && IsWithinPortalOpening(IntersectionPoint);
+}
+
+bool APPortal::IsWithinPortalOpening(const FVector& PointOnPlane) const
+{
+	// Portals placed in the level without a wall have no extents, their whole plane counts
+	if (Extents.IsNearlyZero())
+		return true;
+
+	const FVector LocalPoint = PortalMesh->GetComponentTransform().InverseTransformPositionNoScale(PointOnPlane);
+	return FMath::Abs(LocalPoint.Y) <= Extents.X && FMath::Abs(LocalPoint.Z) <= Extents.Y;
+}
+
+FVector APPortal::GetTrackedPoint(const AActor* Actor) const
+{
+	if (Actor->IsA<APCharacter>())
+		return PlayerCamera->GetComponentLocation();
+
+	return Actor->GetRootComponent()->GetComponentLocation();
+}
+
+FVector APPortal::GetTrackedGravity(const AActor* Actor) const
+{
+	if (const APCharacter* Character = Cast<APCharacter>(Actor))
+	{
+		const UCharacterMovementComponent* Movement = Character->GetCharacterMovement();
+		return Movement->IsFalling() ? FVector(0.0f, 0.0f, Movement->GetGravityZ()) : FVector::ZeroVector;
+	}
+
+	const UPrimitiveComponent* Comp = Cast<UPrimitiveComponent>(Actor->GetRootComponent());
+	if (Comp && Comp->IsSimulatingPhysics() && Comp->IsGravityEnabled())
+		return FVector(0.0f, 0.0f, GetWorld()->GetGravityZ());
+
+	return FVector::ZeroVector;
+}
+
+bool APPortal::FindSweptCrossing(const AActor* TrackedActor, const FVector& LastLocation, const FVector& CurrentLocation, float DeltaTime, FPortalCrossing& OutCrossing) const
+{
+	const FPlane PortalPlane = FPlane(PortalMesh->GetComponentLocation(), PortalMesh->GetForwardVector());
+	const FVector Gravity = GetTrackedGravity(TrackedActor);
+	const double Step = FMath::Max(DeltaTime, UE_KINDA_SMALL_NUMBER);
+
+	// Ballistic path going through both locations: P(t) = Last + StartVelocity * t + Gravity * t^2 / 2, with P(Step) = Current
+	const FVector StartVelocity = (CurrentLocation - LastLocation) / Step - Gravity * (0.5 * Step);
+
+	// Distance to the plane along that path is A * t^2 + B * t + C
+	const double A = 0.5 * (PortalPlane.GetNormal() | Gravity);
+	const double B = PortalPlane.GetNormal() | StartVelocity;
+	const double C = PortalPlane.PlaneDot(LastLocation);
+
+	// The straight segment always crosses, it's the fallback when the path has no root within the step
+	double CrossingTime = Step * C / (C - PortalPlane.PlaneDot(CurrentLocation));
+	if (FMath::Abs(A) > UE_SMALL_NUMBER)
+	{
+		const double Discriminant = B * B - 4.0 * A * C;
+		if (Discriminant >= 0.0)
+		{
+			const double Root = FMath::Sqrt(Discriminant);
+			const double FirstTime = FMath::Min((-B - Root) / (2.0 * A), (-B + Root) / (2.0 * A));
+			const double SecondTime = FMath::Max((-B - Root) / (2.0 * A), (-B + Root) / (2.0 * A));
+			if (FirstTime >= 0.0 && FirstTime <= Step)
+				CrossingTime = FirstTime;
+			else if (SecondTime >= 0.0 && SecondTime <= Step)
+				CrossingTime = SecondTime;
+		}
+	}
+	CrossingTime = FMath::Clamp(CrossingTime, 0.0, Step);
+
+	OutCrossing.Location = LastLocation + StartVelocity * CrossingTime + Gravity * (0.5 * CrossingTime * CrossingTime);
+	OutCrossing.Gravity = Gravity;
+	OutCrossing.RemainingTime = Step - CrossingTime;
+
+	// Going past the plane around the portal isn't a crossing
+	return IsWithinPortalOpening(OutCrossing.Location);
+}
+
 bool APPortal::IsPointCrossingPortal(const FVector& StartPoint, const FVector& Point, FVector& OutIntersectionPoint) const
 {
 	const FPlane PortalPlane = FPlane(PortalMesh->GetComponentLocation(), PortalMesh->GetForwardVector());
@@ -253,24 +615,21 @@ void APPortal::AddTrackedActor(AActor* ActorToAdd)
 	if (ActorToAdd == nullptr)
 		return;
 
+	if (TrackedActors.Contains(ActorToAdd))
+		return;
+
 	// If it's the pawn track the camera otherwise track the root component
-	FTrackedActor Tracked;
-	if (ActorToAdd->IsA<APCharacter>())
-	{
-		Tracked.TrackedComp = PlayerCamera;
-		Tracked.LastTrackedLocation = PlayerCamera->GetComponentLocation();
-	}
-	else
-	{
-		Tracked.TrackedComp = ActorToAdd->GetRootComponent();
-		Tracked.LastTrackedLocation = ActorToAdd->GetActorLocation();
-	}
+	const bool bIsCharacter = ActorToAdd->IsA<APCharacter>();
+	USceneComponent* TrackedComp = bIsCharacter ? PlayerCamera : ActorToAdd->GetRootComponent();
 
-	TrackedActors.Add(ActorToAdd, Tracked);
-	ActorsBeingTracked++;
+	// The pawn only goes through when walking in from the front, the camera can end up behind the plane without entering
+	TrackedActors.Add(ActorToAdd, TrackedComp, bIsCharacter);
 
 	// Create a visual copy of the tracked actor
 	CopyActor(ActorToAdd);
+
+	if (IsTeleportedOnPhysicsThread(ActorToAdd))
+		PortalSubsystem->MarkPhysicsInputDirty();
 }
 
 void APPortal::RemoveTrackedActor(const AActor* ActorToRemove)
@@ -281,12 +640,41 @@ void APPortal::RemoveTrackedActor(const AActor* ActorToRemove)
 	// Delete copy if there is one
 	DeleteCopy(ActorToRemove);
 
-	TrackedActors.Remove(ActorToRemove);
-	ActorsBeingTracked--;
+	if (TrackedActors.Remove(ActorToRemove) && PortalSubsystem != nullptr)
+		PortalSubsystem->MarkPhysicsInputDirty();
+}
+
+bool APPortal::IsTeleportedOnPhysicsThread(const AActor* Actor) const
+{
+	if (PortalSubsystem == nullptr || PortalSubsystem->IsPhysicsCallbackEnabled() == false || Actor->IsA<APCharacter>())
+		return false;
+
+	const USceneComponent* ActorRootComponent = Actor->GetRootComponent();
+	return ActorRootComponent && ActorRootComponent->IsSimulatingPhysics();
+}
+
+void APPortal::OnPhysicsThreadTeleport(AActor* TeleportedActor)
+{
+	if (TargetPortal == nullptr)
+		return;
+
+	UE_LOG(LogPortal, Log, TEXT("Actor %s teleported on the physics thread"), *TeleportedActor->GetName());
+	PortalSubsystem->AddTeleport();
+
+	// Same as a game thread teleport, the player lets go of the cube and the target portal tracks it from now on
+	APCharacter* Character = PlayerController ? Cast<APCharacter>(PlayerController->GetPawn()) : nullptr;
+	if (Character != nullptr && Character->GetGrabbedComponent() != nullptr && Character->GetGrabbedComponent() == TeleportedActor->GetRootComponent())
+		Character->ReleaseActor();
+
+	RemoveTrackedActor(TeleportedActor);
+	TargetPortal->AddTrackedActor(TeleportedActor);
+	TargetPortal->SetTrackedCopyVisibility(TeleportedActor, true);
 }
 
 void APPortal::CopyActor(AActor* ActorToCopy)
 {
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalCopyActor);
+
 	// Create a copy of the actor
 	if (ActorToCopy == nullptr)
 		return;
@@ -296,65 +684,145 @@ void APPortal::CopyActor(AActor* ActorToCopy)
 	if (ActorToCopy->IsA<APCharacter>())
 		return;
 
-	const FName NewActorName = MakeUniqueObjectName(this, AActor::StaticClass(), "CopiedActor");
-	AActor* NewActor = NewObject<AActor>(this, NewActorName, RF_NoFlags, ActorToCopy);
-	ensureMsgf(NewActor, TEXT("Failed to create new actor in CopyActor."));
-	if (NewActor == nullptr)
+	FTrackedActor* Tracked = TrackedActors.Find(ActorToCopy);
+	if (Tracked == nullptr)
 		return;
 
-	NewActor->RegisterAllComponents();
-
-	TArray<UActorComponent*> StaticMeshes;
-	NewActor->GetComponents(UStaticMeshComponent::StaticClass(), StaticMeshes);
-
-	for (UActorComponent* Comp : StaticMeshes)
+	// Render only copy, no actor at all
+	if (bUseInstancedCopies)
 	{
-		UStaticMeshComponent* StaticMeshComp = Cast<UStaticMeshComponent>(Comp);
-		StaticMeshComp->SetCollisionObjectType(ECC_WorldDynamic);
-		StaticMeshComp->SetCollisionResponseToChannel(ECC_PortalBox, ECR_Ignore);
-		StaticMeshComp->SetCollisionResponseToChannel(ECC_PortalWall, ECR_Ignore);
-		StaticMeshComp->SetCollisionResponseToChannel(ECC_Portal, ECR_Ignore);
-		StaticMeshComp->SetCollisionResponseToChannel(ECC_CompanionCube, ECR_Ignore);
-		StaticMeshComp->SetCollisionResponseToChannel(ECC_Pawn, ECR_Ignore);
-		StaticMeshComp->SetSimulatePhysics(false);
+		CreateProxies(ActorToCopy, *Tracked);
+		if (Tracked->Proxies.Num() > 0)
+			INC_DWORD_STAT(STAT_PortalLiveCopies);
+
+		return;
 	}
 
-	// Update the actor's tracking info
-	FTrackedActor Tracked = TrackedActors.FindRef(ActorToCopy);
-	Tracked.TrackedCopy = NewActor;
-	TrackedActors.Remove(ActorToCopy);
-	TrackedActors.Add(ActorToCopy, Tracked);
+	// Borrow a copy from the pool shared by every portal
+	AActor* NewActor = PortalSubsystem->GetCopyPool().Acquire(ActorToCopy);
+	ensureMsgf(NewActor, TEXT("Failed to create new actor in CopyActor."));
+	if (NewActor == nullptr)
+		return;
+
+	INC_DWORD_STAT(STAT_PortalLiveCopies);
+
+	// Update the actor's tracking info in place
+	Tracked->TrackedCopy = NewActor;
+	Tracked->bCopyVisible = false;
 
 	// Set up location and rotation for this frame
-	const FVector Location = UPPortalHelper::ConvertLocationToPortalSpace(NewActor->GetActorLocation(), this, TargetPortal);
-	const FRotator Rotation = UPPortalHelper::ConvertRotationToPortalSpace(NewActor->GetActorRotation(), this, TargetPortal);
+	const FVector Location = UPPortalHelper::ConvertLocationToPortalSpace(ActorToCopy->GetActorLocation(), this, TargetPortal);
+	const FRotator Rotation = UPPortalHelper::ConvertRotationToPortalSpace(ActorToCopy->GetActorRotation(), this, TargetPortal);
 	NewActor->SetActorLocationAndRotation(Location, Rotation);
 
-	// Map copy to the original actor
-	CopiedActors.Add(NewActor, ActorToCopy);
-
 	// Hide the copy from the main pass until it is overlapping the portal mesh
 	SetCopyVisibility(NewActor, false);
 }
 
 void APPortal::DeleteCopy(const AActor* ActorToDelete)
 {
-	if (TrackedActors.Contains(ActorToDelete) == false)
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalDeleteCopy);
+
+	FTrackedActor* Tracked = TrackedActors.Find(ActorToDelete);
+	if (Tracked == nullptr)
 		return;
 
-	if (AActor* Copy = TrackedActors.FindRef(ActorToDelete).TrackedCopy)
+	if (Tracked->Proxies.Num() > 0)
+		DEC_DWORD_STAT(STAT_PortalLiveCopies);
+
+	DeleteProxies(*Tracked);
+
+	if (AActor* Copy = Tracked->TrackedCopy)
 	{
-		CopiedActors.Remove(Copy);
+		Tracked->TrackedCopy = nullptr;
+		DEC_DWORD_STAT(STAT_PortalLiveCopies);
 
-		if (IsValid(Copy) == false)
-			return;
+		// Give the copy back instead of destroying it, the next actor entering a portal will reuse it
+		SetCopyVisibility(Copy, true);
+		PortalSubsystem->GetCopyPool().Release(Copy);
+	}
+}
 
-		if (UWorld* World = GetWorld())
+void APPortal::CreateProxies(const AActor* ActorToCopy, FTrackedActor& Tracked)
+{
+	const FTransform& ActorTransform = ActorToCopy->GetActorTransform();
+
+	TArray<UStaticMeshComponent*> StaticMeshes;
+	ActorToCopy->GetComponents(StaticMeshes);
+	for (const UStaticMeshComponent* StaticMeshComp : StaticMeshes)
+	{
+		if (StaticMeshComp->GetStaticMesh() == nullptr || StaticMeshComp->IsVisible() == false)
+			continue;
+
+		// Share the batch of any mesh already copied with the same materials
+		int32 BatchIndex = ProxyBatches.IndexOfByPredicate([StaticMeshComp](const FPortalProxyBatch& Batch) { return Batch.Matches(StaticMeshComp); });
+		if (BatchIndex == INDEX_NONE)
 		{
-			World->DestroyActor(Copy);
-			Copy = nullptr;
-			GEngine->ForceGarbageCollection();
+			BatchIndex = ProxyBatches.AddDefaulted();
+			ProxyBatches[BatchIndex].Init(this, StaticMeshComp);
 		}
+
+		FPortalProxyInstance& Proxy = Tracked.Proxies.AddDefaulted_GetRef();
+		Proxy.Batch = BatchIndex;
+		Proxy.Instance = ProxyBatches[BatchIndex].Allocate();
+		Proxy.RelativeTransform = StaticMeshComp->GetComponentTransform().GetRelativeTransform(ActorTransform);
+	}
+
+	// Hide the copy from the main pass until it is overlapping the portal mesh
+	Tracked.bCopyVisible = false;
+
+	// Set up the transforms for this frame
+	if (TargetPortal != nullptr)
+		UpdateProxies(Tracked, GetCopyTransform(ActorToCopy));
+
+	MarkProxyBatchesDirty();
+}
+
+FTransform APPortal::GetCopyTransform(const AActor* TrackedActor)
+{
+	const FTransform& PortalSpaceTransform = GetPortalSpaceTransform();
+	const FTransform& ActorTransform = TrackedActor->GetActorTransform();
+
+	return FTransform(PortalSpaceTransform.TransformRotation(ActorTransform.GetRotation()), PortalSpaceTransform.TransformPosition(ActorTransform.GetLocation()), ActorTransform.GetScale3D());
+}
+
+void APPortal::DeleteProxies(FTrackedActor& Tracked)
+{
+	for (const FPortalProxyInstance& Proxy : Tracked.Proxies)
+		ProxyBatches[Proxy.Batch].Free(Proxy.Instance);
+
+	Tracked.Proxies.Reset();
+	MarkProxyBatchesDirty();
+}
+
+void APPortal::MarkProxyBatchesDirty()
+{
+	for (FPortalProxyBatch& Batch : ProxyBatches)
+		Batch.MarkRenderStateDirty();
+}
+
+void APPortal::UpdateProxies(const FTrackedActor& Tracked, const FTransform& CopyTransform)
+{
+	for (const FPortalProxyInstance& Proxy : Tracked.Proxies)
+		ProxyBatches[Proxy.Batch].SetInstanceTransform(Proxy.Instance, Proxy.RelativeTransform * CopyTransform, Tracked.bCopyVisible);
+}
+
+void APPortal::SetTrackedCopyVisibility(const AActor* TrackedActor, const bool bIsVisible)
+{
+	FTrackedActor* Tracked = TrackedActors.Find(TrackedActor);
+	if (Tracked == nullptr)
+		return;
+
+	Tracked->bCopyVisible = bIsVisible;
+
+	if (Tracked->TrackedCopy != nullptr)
+		SetCopyVisibility(Tracked->TrackedCopy, bIsVisible);
+
+	// Proxies only store their visibility in their transform
+	if (Tracked->Proxies.Num() > 0 && TargetPortal != nullptr)
+	{
+		UpdateProxies(*Tracked, GetCopyTransform(TrackedActor));
+		MarkProxyBatchesDirty();
 	}
 }
 
@@ -372,68 +840,120 @@ void APPortal::SetCopyVisibility(const AActor* Actor, const bool IsVisible)
 	}
 }
 
-void APPortal::UpdateTrackedActors()
+void APPortal::UpdateTrackedActors(float DeltaTime)
 {
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalUpdateTrackedActors);
+
 	if (TargetPortal == nullptr)
 		return;
 
-	if (ActorsBeingTracked <= 0)
+	if (TrackedActors.Num() == 0)
 		return;
 
-	TArray<AActor*> TeleportedActors;
-	for (TMap<AActor*, FTrackedActor>::TIterator TrackedPair = TrackedActors.CreateIterator(); TrackedPair; ++TrackedPair)
+	// Update the positions for the duplicated tracked actors at the target portal, converted in a single batch
+	TArray<int32, TInlineAllocator<8>> Copied;
+	TArray<FVector, TInlineAllocator<8>> CopyLocations;
+	TArray<FQuat, TInlineAllocator<8>> CopyRotations;
+	for (int32 Index = 0; Index < TrackedActors.Num(); Index++)
 	{
-		AActor* TrackedActor = TrackedPair->Key;
+		const FTrackedActor& Tracked = TrackedActors[Index];
+		if (IsValid(Tracked.TrackedCopy) == false && Tracked.Proxies.Num() == 0)
+			continue;
 
-		// Update the positions for the duplicated tracked actors at the target portal
-		AActor* Copy = TrackedPair->Value.TrackedCopy;
-		if (IsValid(Copy))
-		{
-			const FVector ConvertedLocation = UPPortalHelper::ConvertLocationToPortalSpace(TrackedActor->GetActorLocation(), this, TargetPortal);
-			const FRotator ConvertedRotation = UPPortalHelper::ConvertRotationToPortalSpace(TrackedActor->GetActorRotation(), this, TargetPortal);
-			Copy->SetActorLocationAndRotation(ConvertedLocation, ConvertedRotation);
-		}
+		Copied.Add(Index);
+		CopyLocations.Add(Tracked.Actor->GetActorLocation());
+		CopyRotations.Add(Tracked.Actor->GetActorQuat());
+	}
 
-		FTrackedActor TrackedInfo = TrackedPair->Value;
+	UPPortalHelper::ConvertTransformsToPortalSpace(CopyLocations, CopyRotations, this, TargetPortal);
+	for (int32 i = 0; i < Copied.Num(); i++)
+	{
+		const FTrackedActor& Tracked = TrackedActors[Copied[i]];
+		if (IsValid(Tracked.TrackedCopy))
+			Tracked.TrackedCopy->SetActorLocationAndRotation(CopyLocations[i], CopyRotations[i]);
 
-		bool bPassedThroughPortal;
-		FVector CurrPosition;
-		UPrimitiveComponent* Comp = Cast<UPrimitiveComponent>(TrackedActor->GetRootComponent());
-		if (TrackedActor->IsA<APCharacter>())
-		{
-			// We update the collision profile so we can pass through portals, but we do it only when the target portal is active
-			if (Comp->GetCollisionProfileName() != FName("PortalPawn"))
-				Comp->SetCollisionProfileName(FName("PortalPawn"));
-
-			FVector IntersectionPoint;
-			CurrPosition = PlayerCamera->GetComponentLocation();
-			const bool bIsIntersecting = IsPointCrossingPortal(TrackedInfo.LastTrackedLocation, CurrPosition, IntersectionPoint);
-			bPassedThroughPortal = bIsIntersecting && IsPointInFrontOfPortal(TrackedInfo.LastTrackedLocation);
-		}
-		else
-		{
-			// We update the collision profile so we can pass through portals, but we do it only when the target portal is active
-			if (Comp->GetCollisionProfileName() != FName("PortalCube"))
-				Comp->SetCollisionProfileName(FName("PortalCube"));
+		if (Tracked.Proxies.Num() > 0)
+			UpdateProxies(Tracked, FTransform(CopyRotations[i], CopyLocations[i], Tracked.Actor->GetActorScale3D()));
+	}
 
-			FVector IntersectionPoint;
-			CurrPosition = TrackedInfo.TrackedComp->GetComponentLocation();
-			bPassedThroughPortal = IsPointCrossingPortal(TrackedInfo.LastTrackedLocation, CurrPosition, IntersectionPoint);
-		}
+	// Send every proxy moved this frame to the renderer at once instead of once per instance
+	MarkProxyBatchesDirty();
 
-		if (bPassedThroughPortal)
-		{
-			TeleportActor(TrackedActor);
+	// Make sure tracked actors can pass through the portal, but only while the target portal is active
+	for (const FTrackedActor& Tracked : TrackedActors)
+	{
+		UPrimitiveComponent* Comp = Cast<UPrimitiveComponent>(Tracked.Actor->GetRootComponent());
+		const FName ProfileName = GetPassThroughProfileName(Tracked.Actor);
+		if (Comp->GetCollisionProfileName() != ProfileName)
+			Comp->SetCollisionProfileName(ProfileName);
+	}
+
+	// Test every tracked actor against the portal plane at once, then only teleport the ones that went through
+	TArray<int32> CrossedIndices;
+	FPortalCrossingTracker& CrossingTracker = TrackedActors.GetCrossingTracker();
+	CrossingTracker.UpdateCurrentLocations();
+	CrossingTracker.FindCrossings(FPlane(PortalMesh->GetComponentLocation(), PortalMesh->GetForwardVector()), CrossedIndices);
+
+	// Removing tracked actors reorders the crossing indices, keep handles to the crossed entries instead
+	TArray<FTrackedActorHandle> CrossedHandles;
+	TArray<FPortalCrossing> CrossedCrossings;
+	for (const int32 Index : CrossedIndices)
+	{
+		// Simulated bodies already went through during the physics step
+		if (IsTeleportedOnPhysicsThread(TrackedActors[Index].Actor))
+			continue;
 
-			// Add the actor to be removed after teleportation
-			TeleportedActors.Add(TrackedActor);
+		FPortalCrossing Crossing;
+		if (bUseSweptCrossing && FindSweptCrossing(TrackedActors[Index].Actor, CrossingTracker.GetLastLocation(Index), CrossingTracker.GetCurrentLocation(Index), DeltaTime, Crossing) == false)
+			continue;
+
+		CrossedHandles.Add(TrackedActors.GetHandle(Index));
+		CrossedCrossings.Add(Crossing);
+	}
 
-			// Skip to the next actor
+	CrossingTracker.AdvanceLocations();
+
+	// Fast movers that didn't go through after all are dropped, they are picked up again next step if still incoming
+	TArray<FTrackedActorHandle> DroppedHandles;
+	for (int32 Index = 0; Index < TrackedActors.Num(); Index++)
+	{
+		if (TrackedActors[Index].bSpeculative && CrossedHandles.Contains(TrackedActors.GetHandle(Index)) == false)
+			DroppedHandles.Add(TrackedActors.GetHandle(Index));
+	}
+
+	for (const FTrackedActorHandle Handle : DroppedHandles)
+	{
+		const FTrackedActor* Tracked = TrackedActors.Find(Handle);
+		if (Tracked == nullptr)
 			continue;
+
+		// Hit the wall again like before it was picked up
+		UPrimitiveComponent* Comp = Cast<UPrimitiveComponent>(Tracked->Actor->GetRootComponent());
+		if (Comp != nullptr && Tracked->SpeculativeProfileName != NAME_None)
+			Comp->SetCollisionProfileName(Tracked->SpeculativeProfileName);
+
+		RemoveTrackedActor(Tracked->Actor);
+	}
+
+	// Teleporting can end overlaps and reorder the tracked actors, resolve the actors first
+	TArray<AActor*> TeleportedActors;
+	TArray<FPortalCrossing> Crossings;
+	for (int32 i = 0; i < CrossedHandles.Num(); i++)
+	{
+		if (const FTrackedActor* Tracked = TrackedActors.Find(CrossedHandles[i]))
+		{
+			TeleportedActors.Add(Tracked->Actor);
+			Crossings.Add(CrossedCrossings[i]);
 		}
+	}
 
-		// Update the last tracked position if we don't teleport the actor
-		TrackedInfo.LastTrackedLocation = CurrPosition;
+	if (TeleportedActors.Num() == 0)
+		return;
+
+	for (int32 i = 0; i < TeleportedActors.Num(); i++)
+	{
+		if (IsValid(TeleportedActors[i]))
+			TeleportActorFromCrossing(TeleportedActors[i], bUseSweptCrossing ? &Crossings[i] : nullptr);
 	}
 
 	// Ensure the tracked actor has been removed, added to the target portal it's been teleported to, and it's copy is not hidden from the render pass
@@ -442,26 +962,31 @@ void APPortal::UpdateTrackedActors()
 		if (IsValid(Actor) == false)
 			continue;
 
-		if (TrackedActors.Contains(Actor))
-			TrackedActors.Remove(Actor);
+		RemoveTrackedActor(Actor);
 
-		if (TargetPortal->TrackedActors.Contains(Actor) == false)
-			TargetPortal->TrackedActors.Add(Actor);
+		// Teleporting usually starts the overlap with the target portal box already
+		TargetPortal->AddTrackedActor(Actor);
 
-		if (const AActor* Copy = TargetPortal->TrackedActors.FindRef(Actor).TrackedCopy)
-			SetCopyVisibility(Copy, true);
+		TargetPortal->SetTrackedCopyVisibility(Actor, true);
 	}
 }
 
 void APPortal::TeleportActor(AActor* ActorToTeleport)
 {
+	TeleportActorFromCrossing(ActorToTeleport, nullptr);
+}
+
+void APPortal::TeleportActorFromCrossing(AActor* ActorToTeleport, const FPortalCrossing* Crossing)
+{
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalTeleportActor);
+
 	if (ActorToTeleport == nullptr || TargetPortal == nullptr)
 		return;
 
-	UE_LOG(LogPortal, Log, TEXT("Teleporting Actor %s"), *ActorToTeleport->GetName());
+	if (PortalSubsystem != nullptr)
+		PortalSubsystem->AddTeleport();
 
-	// Perform a camera cut so the teleportation is seamless with the render functions
-	SceneCapture->bCameraCutThisFrame = true;
+	UE_LOG(LogPortal, Log, TEXT("Teleporting Actor %s"), *ActorToTeleport->GetName());
 
 	FVector SavedVelocity = FVector::ZeroVector;
 	APCharacter* Character = nullptr;
@@ -473,12 +998,23 @@ void APPortal::TeleportActor(AActor* ActorToTeleport)
 		SavedVelocity = Character->GetCharacterMovement()->Velocity;
 	}
 
+	const FTransform& PortalSpaceTransform = GetPortalSpaceTransform();
+
+	// Gravity doesn't turn with the portal, after a swept crossing only the rest of the step is spent under the exit side's gravity
+	FVector GravityCorrection = FVector::ZeroVector;
+	float RemainingTime = 0.0f;
+	if (Crossing != nullptr)
+	{
+		GravityCorrection = Crossing->Gravity - PortalSpaceTransform.TransformVectorNoScale(Crossing->Gravity);
+		RemainingTime = Crossing->RemainingTime;
+	}
+
 	// Compute and apply the new location
-	const FVector NewLocation = UPPortalHelper::ConvertLocationToPortalSpace(ActorToTeleport->GetActorLocation(), this, TargetPortal);
+	const FVector NewLocation = PortalSpaceTransform.TransformPosition(ActorToTeleport->GetActorLocation()) + GravityCorrection * (0.5f * RemainingTime * RemainingTime);
 	ActorToTeleport->SetActorLocation(NewLocation, false, nullptr, ETeleportType::TeleportPhysics);
 
 	// Compute and apply new rotation
-	FRotator NewRotation = UPPortalHelper::ConvertRotationToPortalSpace(ActorToTeleport->GetActorRotation(), this, TargetPortal);
+	FRotator NewRotation = PortalSpaceTransform.TransformRotation(ActorToTeleport->GetActorQuat()).Rotator();
 	ActorToTeleport->SetActorRotation(NewRotation);
 
 	// Update controller and reapply velocity to teleported character
@@ -487,12 +1023,12 @@ void APPortal::TeleportActor(AActor* ActorToTeleport)
 		APPlayerController* PC = Cast<APPlayerController>(Character->GetController());
 		if (PC != nullptr)
 		{
-			NewRotation = UPPortalHelper::ConvertRotationToPortalSpace(PC->GetControlRotation(), this, TargetPortal);
+			NewRotation = PortalSpaceTransform.TransformRotation(PC->GetControlRotation().Quaternion()).Rotator();
 			NewRotation.Roll = 0.0f; // Cancel roll
 			PC->SetControlRotation(NewRotation);
 		}
 
-		const FVector NewVelocity = UPPortalHelper::ConvertDirectionToPortalSpace(SavedVelocity, this, TargetPortal);
+		const FVector NewVelocity = PortalSpaceTransform.TransformVectorNoScale(SavedVelocity) + GravityCorrection * RemainingTime;
 		Character->GetCharacterMovement()->Velocity = NewVelocity;
 
 		Character->ReleaseActor();
@@ -512,8 +1048,8 @@ void APPortal::TeleportActor(AActor* ActorToTeleport)
 			}
 		}
 		
-		const FVector NewLinearVelocity = UPPortalHelper::ConvertDirectionToPortalSpace(Comp->GetPhysicsLinearVelocity(), this, TargetPortal);
-		const FVector NewAngularVelocity = UPPortalHelper::ConvertDirectionToPortalSpace(Comp->GetPhysicsAngularVelocityInDegrees(), this, TargetPortal);
+		const FVector NewLinearVelocity = PortalSpaceTransform.TransformVectorNoScale(Comp->GetPhysicsLinearVelocity()) + GravityCorrection * RemainingTime;
+		const FVector NewAngularVelocity = PortalSpaceTransform.TransformVectorNoScale(Comp->GetPhysicsAngularVelocityInDegrees());
 		Comp->SetPhysicsLinearVelocity(NewLinearVelocity);
 		Comp->SetPhysicsAngularVelocityInDegrees(NewAngularVelocity);
 	}
@@ -522,48 +1058,126 @@ void APPortal::TeleportActor(AActor* ActorToTeleport)
 	TargetPortal->UpdatePortalView();
 
 	// Make sure the copy created is not hidden after teleportation
-	if (TargetPortal->TrackedActors.Contains(ActorToTeleport))
-	{
-		if (const AActor* Copy = TargetPortal->TrackedActors.FindRef(ActorToTeleport).TrackedCopy)
-			SetCopyVisibility(Copy, true);
-	}
+	TargetPortal->SetTrackedCopyVisibility(ActorToTeleport, true);
 }
 
 void APPortal::UpdatePortalView()
 {
-	// Check if we should resize the render target.
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalUpdateView);
+
+	// Pick the render target for the current viewport size and screen coverage.
 	// NOTE: Maybe use an event if too expensive to check viewport size every frame.
 	int32 ViewportX, ViewportY;
 	PlayerController->GetViewportSize(ViewportX, ViewportY);
-	ViewportX *= PortalRenderScale;
-	ViewportY *= PortalRenderScale;
-	UPPortalHelper::ResizeRenderTarget(RenderTarget, ViewportX, ViewportY);
+	UpdateRenderTarget(ViewportX, ViewportY);
 
-	// Get the camera post-processing settings
-	SceneCapture->PostProcessSettings = PlayerCamera->PostProcessSettings;
+	// The capture is shared by every portal, post-processing settings are copied once per frame by the subsystem
+	USceneCaptureComponent2D* SceneCapture = PortalSubsystem->GetSceneCapture();
 
-	// Setup clip plane to cut out objects between the camera and the back of the portal
-	SceneCapture->bEnableClipPlane = true;
+	// Clip plane to cut out objects between the camera and the back of the portal
 	SceneCapture->bOverride_CustomNearClippingPlane = true;
 	SceneCapture->ClipPlaneNormal = TargetPortal->PortalMesh->GetForwardVector();
 	SceneCapture->ClipPlaneBase = TargetPortal->PortalMesh->GetComponentLocation() - (SceneCapture->ClipPlaneNormal * 1.0f);
+	const FPlane ClipPlane(SceneCapture->ClipPlaneBase, SceneCapture->ClipPlaneNormal);
 
 	// Get the projection matrix from the player's camera view settings
+	const FMatrix ProjectionMatrix = PlayerController->GetCameraProjectionMatrix();
 	SceneCapture->bUseCustomProjectionMatrix = true;
-	SceneCapture->CustomProjectionMatrix = PlayerController->GetCameraProjectionMatrix();
 
-	// Get the position of the main camera relative to the target portal
-	const FVector NewCameraLocation = UPPortalHelper::ConvertLocationToPortalSpace(PlayerCamera->GetComponentLocation(), this, TargetPortal);
-	const FRotator NewCameraRotation = UPPortalHelper::ConvertRotationToPortalSpace(PlayerCamera->GetComponentRotation(), this, TargetPortal);
+	const int32 Depth = GetRecursionDepth();
+
+	// Virtual camera of each recursion level, level 0 being the player's view through this portal
+	TArray<FVector, TInlineAllocator<4>> LevelLocations;
+	TArray<FRotator, TInlineAllocator<4>> LevelRotations;
+	const FTransform& PortalSpaceTransform = GetPortalSpaceTransform();
+	FTransform CameraTransform(PlayerCamera->GetComponentQuat(), PlayerCamera->GetComponentLocation());
+	for (int32 Level = 0; Level < Depth; Level++)
+	{
+		CameraTransform = CameraTransform * PortalSpaceTransform;
+		LevelLocations.Add(CameraTransform.GetLocation());
+		LevelRotations.Add(CameraTransform.Rotator());
+	}
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	// Render the deepest level first so each level sees the one behind it on the portal mesh
+	for (int32 Level = Depth - 1; Level >= 0; Level--)
+	{
+		ShowRecursionLevel(Level + 1, Depth, ViewportX, ViewportY);
+
+		SceneCapture->TextureTarget = GetRecursionRenderTarget(Level, ViewportX, ViewportY);
+
+		// Consecutive captures are unrelated views, don't let the shared view state carry any history over
+		SceneCapture->bCameraCutThisFrame = true;
+
+		// Update the scene capture position and rotation
+		SceneCapture->SetWorldLocationAndRotation(LevelLocations[Level], LevelRotations[Level]);
+
+		// Fold the clip plane into the near plane so the global clip plane isn't needed, keep the last texture of a view that can't be made oblique
+		const FMatrix ViewMatrix = UPPortalHelper::MakeViewMatrix(LevelLocations[Level], LevelRotations[Level]);
+		if (UPPortalHelper::MakeObliqueProjectionMatrix(ProjectionMatrix, ViewMatrix, ClipPlane, SceneCapture->CustomProjectionMatrix) == false)
+			continue;
+
+		PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalCaptureScene);
+		SceneCapture->CaptureScene();
+	}
 
-	// Update the scene capture position and rotation
-	SceneCapture->SetWorldLocationAndRotation(NewCameraLocation, NewCameraRotation);
+	// Display the final level on the portal
+	PortalMaterial->SetTextureParameterValue(FName("RenderTarget"), RenderTarget);
 
-	SceneCapture->CaptureScene();
+	const double CaptureTimeMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	AverageCaptureTimeMs = FMath::Lerp(AverageCaptureTimeMs, CaptureTimeMs / Depth, 0.1);
+	PortalSubsystem->AddCaptureTime(CaptureTimeMs);
+}
+
+int32 APPortal::GetRecursionDepth() const
+{
+	const int32 MaxDepth = FMath::Max(1, CVarPortalRecursionDepth.GetValueOnGameThread());
+	const float BudgetMs = CVarPortalRecursionBudget.GetValueOnGameThread();
+
+	if (BudgetMs <= 0.0f || AverageCaptureTimeMs <= 0.0)
+		return MaxDepth;
+
+	// The first level is always rendered, deeper ones only if they fit in what is left of the budget
+	const double RemainingMs = BudgetMs - PortalSubsystem->GetCaptureTimeSpentMs() - AverageCaptureTimeMs;
+	const int32 AffordableLevels = FMath::FloorToInt32(RemainingMs / AverageCaptureTimeMs);
+
+	return FMath::Clamp(1 + AffordableLevels, 1, MaxDepth);
+}
+
+UTextureRenderTarget2D* APPortal::GetRecursionRenderTarget(const int32 Level, const int32 ViewportX, const int32 ViewportY)
+{
+	if (Level == 0)
+		return RenderTarget;
+
+	// Deeper levels are smaller on screen, render them one resolution bucket lower per level
+	const int32 Bucket = FMath::Min(CurrentResolutionBucket + Level, FMath::Max(DynamicResolutionBuckets - 1, 0));
+	const float Scale = PortalRenderScale * GetResolutionBucketScale(Bucket);
+	const int32 SizeX = FMath::Max(1, FMath::RoundToInt(ViewportX * Scale));
+	const int32 SizeY = FMath::Max(1, FMath::RoundToInt(ViewportY * Scale));
+
+	return PortalSubsystem->GetRenderTargetPool().FindOrCreate(PortalSubsystem, this, Bucket, Level, SizeX, SizeY);
+}
+
+void APPortal::ShowRecursionLevel(const int32 Level, const int32 Depth, const int32 ViewportX, const int32 ViewportY)
+{
+	UTextureRenderTarget2D* LevelTarget = nullptr;
+	if (Level < Depth)
+		LevelTarget = GetRecursionRenderTarget(Level, ViewportX, ViewportY);
+	else if (CVarPortalRecursionFallback.GetValueOnGameThread() == 0)
+		LevelTarget = PortalSubsystem->GetRenderTargetPool().FindAny(this, Level); // Last good texture from a frame that had the budget to go deeper
+
+	// Nothing to show, use a 1x1 black texture rather than swapping materials which would recreate the render state
+	if (LevelTarget == nullptr)
+		LevelTarget = PortalSubsystem->GetRenderTargetPool().FindOrCreate(PortalSubsystem, nullptr, 0, FallbackRecursionLevel, 1, 1);
+
+	PortalMaterial->SetTextureParameterValue(FName("RenderTarget"), LevelTarget);
 }
 
 void APPortal::ClearPortalView() const
 {
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalClearView);
+
 	// Force portal to be a random color that can be found as a mask.
 	if (PortalMaterial != nullptr)
 		UKismetRenderingLibrary::ClearRenderTarget2D(GetWorld(), RenderTarget);
@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Portal/Helpers/PPortalProxyBatch.h"
+#include "Portal/Helpers/PPortalTrackedActors.h"
 #include "PPortal.generated.h"
 
 class APCharacter;
@@ -11,29 +13,11 @@ class UCameraComponent;
 class APPlayerController;
 class APPortalWall;
 class UBoxComponent;
+class UPPortalSubsystem;
 
 /* Logging category for this class. */
 DECLARE_LOG_CATEGORY_EXTERN(LogPortal, Log, All);
 
-/* Structure to hold important tracking information with each overlapping actor. */
-USTRUCT(BlueprintType)
-struct FTrackedActor
-{
-	GENERATED_BODY()
-
-	FVector LastTrackedLocation;
-
-	UPROPERTY()
-	USceneComponent* TrackedComp;
-
-	UPROPERTY()
-	AActor* TrackedCopy;
-
-	FTrackedActor() : LastTrackedLocation(FVector::ZeroVector), TrackedComp(nullptr), TrackedCopy(nullptr)
-	{
-	}
-};
-
 /* Post-physics update tick for updating position of physics driven actors. 
  NOTE: This is irrelevant for a pawn that is not physics driven.
  NOTE: This is always a relevant way of tracking actors that are moving via physics.
@@ -49,6 +33,16 @@ struct FPostPhysicsTick : public FActorTickFunction
 	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
 };
 
+/* Where a tracked point went through the portal plane during the last physics step, and what was left of that step. */
+struct FPortalCrossing
+{
+	FVector Location = FVector::ZeroVector;
+	FVector Gravity = FVector::ZeroVector;
+
+	/* Time left in the step after the crossing. */
+	float RemainingTime = 0.0f;
+};
+
 template <>
 struct TStructOpsTypeTraits<FPostPhysicsTick> : public TStructOpsTypeTraitsBase2<FPostPhysicsTick>
 {
@@ -67,17 +61,40 @@ public:
 	APPortal();
 
 	virtual void OnConstruction(const FTransform& Transform) override;
-	virtual void Tick(float DeltaSeconds) override;
+
+	/* Clear and capture the portal view if it is visible, called once per frame by the portal subsystem. */
+	void TickPortalView();
 
 	void Init(bool bIsLeftPortal);
 
+	/* Set the wall the portal was placed on and its extents on it, then notify Blueprint the portal is spawned. */
+	void PlaceOnWall(APPortalWall* Wall, const FVector2D& PortalExtents, bool bIsFloorPortal);
+
+	/* Hand the rendering and linking over to the portal subsystem, done on begin play. */
+	void RegisterWithPortalSubsystem();
+
+	/* Start and stop copying an actor to the other side and teleporting it, done on portal box overlaps. */
+	void AddTrackedActor(AActor* ActorToAdd);
+	void RemoveTrackedActor(const AActor* ActorToRemove);
+
+	/* Move the copies of the tracked actors and teleport the ones that crossed, done every post physics tick. */
+	void UpdateTrackedActors(float DeltaTime);
+
+	bool UsesInstancedCopies() const { return bUseInstancedCopies; }
+
+	/* Switch between instanced and actor copies, only while no actor is tracked. */
+	void SetUseInstancedCopies(bool bInUseInstancedCopies);
+
 	UFUNCTION(BlueprintImplementableEvent, BlueprintCallable, Category = "Portal")
 	void OnPortalSpawned();
 
 	UFUNCTION(Blueprintcallable, Category = "Portal")
 	void LinkPortal(APPortal* OtherPortal);
 
-	/* Update the render texture for this portal using the scene capture component. */
+	/* Stop showing and teleporting to the linked portal, use the portal subsystem to unlink both sides. */
+	void UnlinkPortal();
+
+	/* Update the render texture for this portal using the scene capture shared by the portal subsystem. */
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	void UpdatePortalView();
 
@@ -85,6 +102,10 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Portal")
 	void ClearPortalView() const;
 
+	/* Visibility pre-pass: back-face, frustum and last frame occlusion test of the portal mesh against the player camera. */
+	UFUNCTION(BlueprintCallable, Category = "Portal")
+	bool IsVisibleToPlayer() const;
+
 	UFUNCTION(BlueprintCallable, Category="Portal")
 	void TeleportActor(AActor* ActorToTeleport);
 
@@ -97,6 +118,20 @@ public:
 
 	UStaticMeshComponent* GetPortalMesh() const { return PortalMesh; };
 	APPortal* GetLinkedPortal() const { return TargetPortal; };
+	bool IsLeftPortal() const { return bPortalLeft; }
+	const FPortalTrackedActors& GetTrackedActors() const { return TrackedActors; }
+
+	/* Whether a tracked actor is a simulated body teleported by the physics thread callback of the portal subsystem. */
+	bool IsTeleportedOnPhysicsThread(const AActor* Actor) const;
+
+	/* Move the tracking of an actor the physics thread teleported through this portal to the linked portal. */
+	void OnPhysicsThreadTeleport(AActor* TeleportedActor);
+
+	/* Transform from this portal space to the linked portal space, only rebuilt when either portal moves. */
+	const FTransform& GetPortalSpaceTransform();
+
+	/* Incremented every time the portal mesh moves, used to invalidate the cached portal space transforms. */
+	uint32 GetPortalTransformVersion() const { return PortalTransformVersion; }
 
 	UPROPERTY()
 	APPortalWall* CurrentWall;
@@ -121,6 +156,7 @@ public:
 
 protected:
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 
 	/* Post-physics ticking function. */
 	void PostPhysicsTick(float DeltaTime);
@@ -128,16 +164,79 @@ protected:
 	/* Create a render texture target for this portal. */
 	void CreatePortalTexture();
 
-	void AddTrackedActor(AActor* ActorToAdd);
-	void RemoveTrackedActor(const AActor* ActorToRemove);
+	/* Pick the render target matching the current viewport size and resolution bucket, and bind it to the capture and material. */
+	void UpdateRenderTarget(int32 ViewportX, int32 ViewportY);
+
+	/* Fraction of the viewport covered by the portal mesh bounds, along its largest screen axis. */
+	float ComputeScreenCoverage(int32 ViewportX, int32 ViewportY) const;
+
+	/* Select the resolution bucket for the given screen coverage, upscaling immediately but downscaling with some hysteresis. */
+	int32 SelectResolutionBucket(float Coverage);
+
+	float GetResolutionBucketScale(int32 Bucket) const;
+
+	/* Number of recursion levels to render this frame, from sm.PortalRecursionDepth and what is left of sm.PortalRecursionBudget. */
+	int32 GetRecursionDepth() const;
+
+	/* Render target of a recursion level, level 0 being the one displayed on the portal. */
+	UTextureRenderTarget2D* GetRecursionRenderTarget(int32 Level, int32 ViewportX, int32 ViewportY);
+
+	/* Make the portal material display the given recursion level, or the fallback texture if it is past the rendered depth. */
+	void ShowRecursionLevel(int32 Level, int32 Depth, int32 ViewportX, int32 ViewportY);
+
+	FMatrix GetPlayerViewProjectionMatrix() const;
 
 	/* Hides a copied version of an actor from the main render pass so it still casts shadows. */
 	static void SetCopyVisibility(const AActor* Actor, bool IsVisible);
 
+	/* Show or hide the copy of a tracked actor, whether it is an actor copy or instanced proxies. */
+	void SetTrackedCopyVisibility(const AActor* TrackedActor, bool bIsVisible);
+
 	void CopyActor(AActor* ActorToCopy);
 	void DeleteCopy(const AActor* ActorToDelete);
 
-	void UpdateTrackedActors();
+	/* Add an instance of every static mesh of the actor to the proxy batches. */
+	void CreateProxies(const AActor* ActorToCopy, FTrackedActor& Tracked);
+	void DeleteProxies(FTrackedActor& Tracked);
+
+	/* World transform of the copy of a tracked actor, in front of the target portal. */
+	FTransform GetCopyTransform(const AActor* TrackedActor);
+
+	/* Move the proxies of a tracked actor to where its copy stands. */
+	void UpdateProxies(const FTrackedActor& Tracked, const FTransform& CopyTransform);
+
+	/* Push the proxy instance updates to the renderer, once per batch. */
+	void MarkProxyBatchesDirty();
+
+	/*
+	 Solve the ballistic path between the last and current location of a tracked point for the exact time it crossed the portal plane.
+	 Returns false if the crossing point is outside the portal.
+	 */
+	bool FindSweptCrossing(const AActor* TrackedActor, const FVector& LastLocation, const FVector& CurrentLocation, float DeltaTime, FPortalCrossing& OutCrossing) const;
+
+	/* Whether the segment between two points goes through the portal opening, and not just its plane. */
+	bool IsCrossingPortalOpening(const FVector& StartPoint, const FVector& EndPoint) const;
+	bool IsWithinPortalOpening(const FVector& PointOnPlane) const;
+
+	/* Point whose crossing of the portal plane teleports the actor: the camera for the pawn, the root component otherwise. */
+	FVector GetTrackedPoint(const AActor* Actor) const;
+
+	/* Gravity applied to an actor this step, zero if it is walking or doesn't simulate gravity. */
+	FVector GetTrackedGravity(const AActor* Actor) const;
+
+	/* Start tracking an overlapping actor, including one whose tracked point went past the plane in the same step it entered the box. */
+	void TryTrackEnteringActor(AActor* OverlappedActor);
+
+	/* Track the actors fast enough to go through the portal during the next step without ever being seen overlapping its box. */
+	void TrackIncomingFastMovers(float DeltaTime);
+
+	/* Collision profile letting a tracked actor go through the wall the portal is on. */
+	static FName GetPassThroughProfileName(const AActor* Actor);
+
+	/* Teleport an actor, placing it where it would be at the end of the step if it went through at the exact crossing time. */
+	void TeleportActorFromCrossing(AActor* ActorToTeleport, const FPortalCrossing* Crossing);
+
+	void OnPortalMeshTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<UStaticMeshComponent> PortalBorderMesh;
@@ -160,20 +259,56 @@ protected:
 	UPROPERTY(EditdefaultsOnly, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<UMaterialInterface> DefaultPortalMaterial;
 
-	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
-	TObjectPtr<USceneCaptureComponent2D> SceneCapture;
-
 	UPROPERTY(EditInstanceOnly, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true", ExposeOnSpawn = "true"))
 	bool bPortalLeft;
 
+	/* Portal placed in the level this one is linked to on begin play, for designer placed pairs. */
+	UPROPERTY(EditInstanceOnly, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
+	TObjectPtr<APPortal> InitialLinkedPortal;
+
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
 	float PortalRenderScale;
 
+	/* Skip the capture and clear of this portal on frames where the player cannot see it. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
+	bool bSkipHiddenPortalCapture;
+
+	/* Size the render target from the portal's on-screen coverage instead of always rendering at full viewport resolution. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
+	bool bUseDynamicResolution;
+
+	/* Resolution scale of the smallest bucket. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true", ClampMin = "0.05", ClampMax = "1.0", EditCondition = "bUseDynamicResolution"))
+	float MinDynamicResolutionScale;
+
+	/* Number of render target sizes between full resolution and MinDynamicResolutionScale. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true", ClampMin = "1", ClampMax = "8", EditCondition = "bUseDynamicResolution"))
+	int32 DynamicResolutionBuckets;
+
+	/* Coverage multiplier, a portal covering 1 / CoverageResolutionScale of the screen renders at full resolution. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true", ClampMin = "1.0", EditCondition = "bUseDynamicResolution"))
+	float CoverageResolutionScale;
+
+	/* Detect crossings along the path of the tracked actors during the physics step instead of only comparing positions. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
+	bool bUseSweptCrossing;
+
+	/* Highest speed, in cm/s, of the actors tracked before they reach the portal box. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true", ClampMin = "0.0", EditCondition = "bUseSweptCrossing"))
+	float MaxSweptCrossingSpeed;
+
+	/* Show actors going through the portal with instanced, collision free meshes instead of copying the whole actor. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
+	bool bUseInstancedCopies;
+
 	FPostPhysicsTick PhysicsTick;
 
 	UPROPERTY()
 	APPortal* TargetPortal;
 
+	UPROPERTY()
+	TObjectPtr<UPPortalSubsystem> PortalSubsystem;
+
 	UPROPERTY()
 	APPlayerController* PlayerController;
 
@@ -183,15 +318,31 @@ protected:
 	UPROPERTY()
 	UTextureRenderTarget2D* RenderTarget;
 
+	int32 CurrentResolutionBucket;
+	int32 FramesBelowResolutionBucket;
+
+	/* Running average of the game thread cost of one capture, used to fit the recursion in the frame budget. */
+	double AverageCaptureTimeMs;
+
+	/* Screen coverage of the portal this frame, computed once before capturing. */
+	float ScreenCoverage;
+
 	UPROPERTY()
 	UMaterialInstanceDynamic* PortalMaterial;
 
 	UPROPERTY()
-	TMap<AActor*, FTrackedActor> TrackedActors; 
+	FPortalTrackedActors TrackedActors;
 
+	/* Instanced copies of the tracked actor meshes, one batch per mesh and materials combination. */
 	UPROPERTY()
-	TMap<AActor*, AActor*> CopiedActors; 
+	TArray<FPortalProxyBatch> ProxyBatches;
 	
+	uint32 PortalTransformVersion;
+
+	/* Portal space transform to TargetPortal, valid while both portals are at the versions it was built with. */
+	FTransform CachedPortalSpaceTransform;
+	uint32 CachedOriginTransformVersion;
+	uint32 CachedTargetTransformVersion;
+
 	bool bInitialized;
-	int ActorsBeingTracked;
 };
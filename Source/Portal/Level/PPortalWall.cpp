@@ -4,6 +4,9 @@
 #include "PPortalWall.h"
 #include "DrawDebugHelpers.h"
 #include "PGhostPortalBorder.h"
+#include "PPortal.h"
+#include "Portal/Subsystems/PPortalSubsystem.h"
+#include "Portal/Subsystems/PPortalWallSubsystem.h"
 
 extern TAutoConsoleVariable<bool> CVarDebugDrawTrace;
 
@@ -20,65 +23,77 @@ void APPortalWall::OnConstruction(const FTransform& Transform)
 {
 	Super::OnConstruction(Transform);
 
+	UpdateMeshScale();
+}
+
+void APPortalWall::SetSize(const float InWidth, const float InHeight)
+{
+	Width = InWidth;
+	Height = InHeight;
+	UpdateMeshScale();
+}
+
+void APPortalWall::UpdateMeshScale() const
+{
 	const FVector WorldScale = FVector(1.0f, Width / 100, Height / 100); // The mesh is 100 by 100 cm
 	MeshComp->SetWorldScale3D(WorldScale);
 }
 
-bool APPortalWall::TryGetPortalPos_Implementation(const FVector& Origin, const APGhostPortalBorder* GhostBorder, const bool bIsLeftPortal, FVector& OutPortalPosition, FVector2D& OutPortalExtents) const
+void APPortalWall::BeginPlay()
 {
-	const bool bDrawDebug = CVarDebugDrawTrace.GetValueOnGameThread();
+	Super::BeginPlay();
 
-	TArray<FVector> Vertices = GhostBorder->GetVertices();
-	ensureMsgf(Vertices.Num() > 0, TEXT("Vertices is empty."));
+	if (Holes.Num() > MaxPlacementHoles)
+		UE_LOG(LogPortal, Warning, TEXT("Portal wall %s has %d holes, portal placement only avoids the first %d."), *GetName(), Holes.Num(), MaxPlacementHoles);
 
-	TArray<FVector> WorldVertices;
-	const int32 NumVertices = Vertices.Num();
-	for (int32 i = 0; i < NumVertices; i++)
+	if (UPPortalWallSubsystem* WallSubsystem = GetWorld()->GetSubsystem<UPPortalWallSubsystem>())
 	{
-		FVector RotatedVertex = GhostBorder->GetRelativeRotation().RotateVector(Vertices[i]);
-		FVector WorldVertex = GhostBorder->GetActorTransform().TransformPosition(RotatedVertex);
-
-		WorldVertices.Add(WorldVertex);
+		WallSubsystem->RegisterWall(this);
+		MeshComp->TransformUpdated.AddUObject(this, &APPortalWall::OnMeshTransformUpdated);
 	}
+}
 
-	FVector LocalVertex = GetTransform().InverseTransformPosition(WorldVertices[0]);
+void APPortalWall::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPPortalWallSubsystem* WallSubsystem = GetWorld()->GetSubsystem<UPPortalWallSubsystem>())
+		WallSubsystem->UnregisterWall(this);
 
-	float MaxZ, MaxY;
-	float MinZ = MaxZ = LocalVertex.Z;
-	float MinY = MaxY = LocalVertex.Y;
+	MeshComp->TransformUpdated.RemoveAll(this);
 
-	for (int i = 1; i < WorldVertices.Num(); ++i)
-	{
-		LocalVertex = GetTransform().InverseTransformPosition(WorldVertices[i]);
+	Super::EndPlay(EndPlayReason);
+}
 
-		MinZ = FMath::Min(MinZ, LocalVertex.Z);
-		MinY = FMath::Min(MinY, LocalVertex.Y);
-		MaxZ = FMath::Max(MaxZ, LocalVertex.Z);
-		MaxY = FMath::Max(MaxY, LocalVertex.Y);
-	}
+void APPortalWall::OnMeshTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport)
+{
+	if (UPPortalWallSubsystem* WallSubsystem = GetWorld()->GetSubsystem<UPPortalWallSubsystem>())
+		WallSubsystem->UpdateWall(this);
+}
 
-	const float PortalWidth = MaxY - MinY;
-	const float PortalHeight = MaxZ - MinZ;
+bool APPortalWall::TryGetPortalPos_Implementation(const FVector& Origin, const APGhostPortalBorder* GhostBorder, const bool bIsLeftPortal, FVector& OutPortalPosition, FVector2D& OutPortalExtents) const
+{
+	const bool bDrawDebug = CVarDebugDrawTrace.GetValueOnGameThread();
 
-	if (PortalWidth > Width || PortalHeight > Height)
-		return false;
+	// Size of the border on this wall from its cached hull, only its rotation relative to the wall matters
+	const FVector2D BorderHalfExtents = GhostBorder->GetHalfExtentsOnWall(GetTransform());
+	const float PortalHalfWidth = BorderHalfExtents.X;
+	const float PortalHalfHeight = BorderHalfExtents.Y;
 
-	const float PortalHalfWidth = PortalWidth / 2;
-	const float PortalHalfHeight = PortalHeight / 2;
+	if (PortalHalfWidth * 2 > Width || PortalHalfHeight * 2 > Height)
+		return false;
 
 	OutPortalExtents = FVector2D(PortalHalfWidth, PortalHalfHeight);
 
+	// Move the portal to the nearest spot where it fits, inside the wall and away from holes and the other portal
 	const FVector RelativeLocation = GetTransform().InverseTransformPosition(Origin);
-	const bool bIsOutsideWallZ = FMath::Abs(RelativeLocation.Z) + PortalHalfHeight > Height / 2;
-	const bool bIsOutsideWallY = FMath::Abs(RelativeLocation.Y) + PortalHalfWidth > Width / 2;
+	const FVector2D DesiredLocation(RelativeLocation.Y, RelativeLocation.Z);
+	FVector2D PlacedLocation;
+	if (FindPortalPlacement(DesiredLocation, OutPortalExtents, bIsLeftPortal, PlacedLocation) == false)
+		return false;
 
 	OutPortalPosition = Origin;
 
-	if (bIsOutsideWallY || bIsOutsideWallZ)
-	{
-		const FVector ConstrainedLocation = ConstrainPortalToWall(RelativeLocation, PortalHalfWidth, PortalHalfHeight);
-		OutPortalPosition = GetTransform().TransformPosition(ConstrainedLocation);
-	}
+	if (PlacedLocation != DesiredLocation)
+		OutPortalPosition = GetTransform().TransformPosition(FVector(RelativeLocation.X, PlacedLocation.X, PlacedLocation.Y));
 
 	if (bDrawDebug)
 	{
@@ -89,31 +104,88 @@ bool APPortalWall::TryGetPortalPos_Implementation(const FVector& Origin, const A
 	return true;
 }
 
-FVector APPortalWall::ConstrainPortalToWall(const FVector& RelativeLocation, const float PortalHalfWidth, const float PortalHalfHeight) const
+bool APPortalWall::FindPortalPlacement(const FVector2D& DesiredLocation, const FVector2D& PortalHalfExtents, const bool bIsLeftPortal, FVector2D& OutLocation) const
 {
-	constexpr float MinFloat = -1000000000.0f;
+	// Where the portal center can be for the portal to stay inside the wall
+	const FBox2D Area(FVector2D(-Width / 2 + PortalHalfExtents.X, -Height / 2 + PortalHalfExtents.Y), FVector2D(Width / 2 - PortalHalfExtents.X, Height / 2 - PortalHalfExtents.Y));
+	if (Area.Min.X > Area.Max.X || Area.Min.Y > Area.Max.Y)
+		return false;
+
+	// Where it can't be, other portals and holes grown by the portal size. Portals come first and are never dropped,
+	// otherwise the spot found could overlap one and be rejected by the placement check
+	TArray<FBox2D, TInlineAllocator<MaxPlacementBlockers>> Blockers;
+	const FVector2D Margin = PortalHalfExtents + FVector2D(PlacementMargin);
+	if (const UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>())
+	{
+		for (const APPortal* Portal : PortalSubsystem->GetPortals())
+		{
+			// The portal of the same side is the one being moved
+			if (IsValid(Portal) == false || Portal->CurrentWall != this || Portal->IsLeftPortal() == bIsLeftPortal)
+				continue;
+
+			const FVector PortalLocation = GetTransform().InverseTransformPosition(Portal->GetActorLocation());
+			const FVector2D PortalCenter(PortalLocation.Y, PortalLocation.Z);
+			Blockers.Add(FBox2D(PortalCenter - Portal->Extents - Margin, PortalCenter + Portal->Extents + Margin));
+		}
+	}
 
-	FVector ConstrainedLocation = RelativeLocation;
+	for (int32 i = 0; i < FMath::Min(Holes.Num(), MaxPlacementHoles); i++)
+		Blockers.Add(FBox2D(Holes[i].Min - Margin, Holes[i].Max + Margin));
 
-	// Vertical
-	const float ZPosition = RelativeLocation.Z;
-	float ZDelta = Height / 2 - PortalHalfHeight - FMath::Abs(ZPosition);
-	ZDelta = FMath::Clamp(ZDelta, MinFloat, 0.0f);
+	// Blockers are open, a portal touching another one is fine
+	auto IsFree = [&Blockers](const FVector2D& Point)
+	{
+		for (const FBox2D& Blocker : Blockers)
+		{
+			if (Point.X > Blocker.Min.X && Point.X < Blocker.Max.X && Point.Y > Blocker.Min.Y && Point.Y < Blocker.Max.Y)
+				return false;
+		}
 
-	if (ZPosition > 0.0f)
-		ZDelta *= -1.0f;
+		return true;
+	};
 
-	ConstrainedLocation.Z -= ZDelta;
+	const FVector2D ClampedLocation(FMath::Clamp(DesiredLocation.X, Area.Min.X, Area.Max.X), FMath::Clamp(DesiredLocation.Y, Area.Min.Y, Area.Max.Y));
+	if (IsFree(ClampedLocation))
+	{
+		OutLocation = ClampedLocation;
+		return true;
+	}
+
+	// Otherwise the nearest free spot is on a blocker or wall edge, either in line with the desired location or at a corner where two edges meet.
+	// All of them are on the grid made of the edge coordinates and the desired coordinates, (2 * Blockers + 3)^2 candidates at most.
+	TArray<double, TInlineAllocator<MaxPlacementBlockers * 2 + 3>> CandidateXs = { ClampedLocation.X, Area.Min.X, Area.Max.X };
+	TArray<double, TInlineAllocator<MaxPlacementBlockers * 2 + 3>> CandidateYs = { ClampedLocation.Y, Area.Min.Y, Area.Max.Y };
+	for (const FBox2D& Blocker : Blockers)
+	{
+		if (Blocker.Min.X >= Area.Min.X && Blocker.Min.X <= Area.Max.X)
+			CandidateXs.Add(Blocker.Min.X);
 
-	// Horizontal
-	const float YPosition = RelativeLocation.Y;
-	float YDelta = Width / 2 - PortalHalfWidth - FMath::Abs(YPosition);
-	YDelta = FMath::Clamp(YDelta, MinFloat, 0.0f);
+		if (Blocker.Max.X >= Area.Min.X && Blocker.Max.X <= Area.Max.X)
+			CandidateXs.Add(Blocker.Max.X);
 
-	if (YPosition > 0.0f)
-		YDelta *= -1.0f;
+		if (Blocker.Min.Y >= Area.Min.Y && Blocker.Min.Y <= Area.Max.Y)
+			CandidateYs.Add(Blocker.Min.Y);
 
-	ConstrainedLocation.Y -= YDelta;
+		if (Blocker.Max.Y >= Area.Min.Y && Blocker.Max.Y <= Area.Max.Y)
+			CandidateYs.Add(Blocker.Max.Y);
+	}
+
+	bool bFound = false;
+	double BestDistanceSquared = UE_BIG_NUMBER;
+	for (const double X : CandidateXs)
+	{
+		for (const double Y : CandidateYs)
+		{
+			const FVector2D Candidate(X, Y);
+			const double DistanceSquared = FVector2D::DistSquared(Candidate, DesiredLocation);
+			if (DistanceSquared >= BestDistanceSquared || IsFree(Candidate) == false)
+				continue;
+
+			bFound = true;
+			BestDistanceSquared = DistanceSquared;
+			OutLocation = Candidate;
+		}
+	}
 
-	return ConstrainedLocation;
+	return bFound;
 }
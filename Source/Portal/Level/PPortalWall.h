@@ -22,8 +22,40 @@ public:
 	UFUNCTION(BlueprintNativeEvent, Category = "Portal")
 	bool TryGetPortalPos(const FVector& Origin, const APGhostPortalBorder* GhostBorder, bool bIsLeftPortal, FVector& OutPortalPosition, FVector2D& OutPortalExtents) const;
 
+	UStaticMeshComponent* GetMesh() const { return MeshComp; }
+
+	/* Resize the wall and scale its mesh to match, in centimeters. */
+	void SetSize(float InWidth, float InHeight);
+
+	/* Rectangles of the wall no portal can overlap, in wall space Y and Z centimeters. */
+	void SetHoles(const TArray<FBox2D>& InHoles) { Holes = InHoles; }
+
+	/*
+	 Nearest location to DesiredLocation, in wall space Y and Z, where a portal of the given half extents fits on the wall.
+	 The portals of the other side already on the wall and the first MaxPlacementHoles holes are avoided.
+	 Bounded cost, cheap enough to run every frame for a preview.
+	 Returns false if the portal fits nowhere.
+	 */
+	bool FindPortalPlacement(const FVector2D& DesiredLocation, const FVector2D& PortalHalfExtents, bool bIsLeftPortal, FVector2D& OutLocation) const;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
-	FVector ConstrainPortalToWall(const FVector& RelativeLocation, float PortalHalfWidth, float PortalHalfHeight) const;
+	void UpdateMeshScale() const;
+
+	/* Keep the wall registry up to date when the wall moves. */
+	void OnMeshTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport);
+
+	/* Holes past this count are ignored by the placement, portals on the wall never are. */
+	static constexpr int32 MaxPlacementHoles = 8;
+
+	/* Inline capacity of the placement blockers, the holes plus the usual other portal or two. */
+	static constexpr int32 MaxPlacementBlockers = MaxPlacementHoles + 2;
+
+	/* Gap kept between portals so that rounding never makes them overlap. */
+	static constexpr double PlacementMargin = 0.1;
 	
 	UPROPERTY(EditDefaultsOnly, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
 	TObjectPtr<USceneComponent> SceneRoot;
@@ -36,4 +68,8 @@ private:
 
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
 	float Height;
+
+	/* Rectangles of the wall no portal can overlap, in wall space Y and Z centimeters. */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Portal", meta = (AllowPrivateAccess = "true"))
+	TArray<FBox2D> Holes;
 };
@@ -0,0 +1,41 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PSignalGate.h"
+
+
+APSignalGate::APSignalGate() : Logic(EPSignalLogic::And), HoldTime(3.0f)
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComp = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+	RootComponent = RootComp;
+}
+
+bool APSignalGate::IsActive() const
+{
+	const UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>();
+	return SignalSubsystem && SignalSubsystem->IsActive(this);
+}
+
+void APSignalGate::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>();
+	if (SignalSubsystem == nullptr)
+		return;
+
+	ensureMsgf(Logic != EPSignalLogic::Source, TEXT("'%s' A signal gate can't be a source."), *GetNameSafe(this));
+
+	const TArray<const UObject*> InputObjects(Inputs);
+	SignalSubsystem->AddNode(this, Logic, InputObjects, FOnSignalChanged::CreateUObject(this, &APSignalGate::OnGateChanged), HoldTime);
+}
+
+void APSignalGate::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UPSignalSubsystem* SignalSubsystem = GetWorld()->GetSubsystem<UPSignalSubsystem>())
+		SignalSubsystem->RemoveNode(this);
+
+	Super::EndPlay(EndPlayReason);
+}
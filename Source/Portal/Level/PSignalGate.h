@@ -0,0 +1,44 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Portal/Subsystems/PSignalSubsystem.h"
+#include "PSignalGate.generated.h"
+
+/* Logic gate of the signal network, combines triggers and other gates to drive doors and devices. */
+UCLASS()
+class PORTAL_API APSignalGate : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	APSignalGate();
+
+	UFUNCTION(BlueprintPure, Category = "Signal")
+	bool IsActive() const;
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	/* Called when the gate state changes, to drive indicator lights for example. */
+	UFUNCTION(BlueprintImplementableEvent)
+	void OnGateChanged(bool bIsActive);
+
+private:
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
+	TObjectPtr<USceneComponent> RootComp;
+
+	UPROPERTY(EditInstanceOnly, BlueprintReadOnly, Category = "Signal", meta = (AllowPrivateAccess = "true", InvalidEnumValues = "Source"))
+	EPSignalLogic Logic;
+
+	/* Triggers, gates or any actor registered in the signal network. */
+	UPROPERTY(EditInstanceOnly, BlueprintReadOnly, Category = "Signal", meta = (AllowPrivateAccess = "true"))
+	TArray<TObjectPtr<AActor>> Inputs;
+
+	/* Seconds a timer gate stays active after its last input deactivates. */
+	UPROPERTY(EditInstanceOnly, BlueprintReadOnly, Category = "Signal", meta = (AllowPrivateAccess = "true", ClampMin = "0", EditCondition = "Logic == EPSignalLogic::Timer"))
+	float HoldTime;
+};
@@ -8,15 +8,20 @@
 #include "EnhancedInputSubsystems.h"
 #include "InputActionValue.h"
 #include "PGunComponent.h"
+#include "Portal.h"
 #include "Engine/LocalPlayer.h"
 #include "GameFramework/CharacterMovementComponent.h"
 #include "Helpers/PPortalHelper.h"
 #include "Level/PPortal.h"
 #include "PhysicsEngine/PhysicsHandleComponent.h"
+#include "Subsystems/PPortalSubsystem.h"
 
 DEFINE_LOG_CATEGORY(LogPortalCharacter);
 
 TAutoConsoleVariable<bool> CVarDebugDrawTrace(TEXT("sm.TraceDebugDraw"), false, TEXT("Enable Debug Lines for Character Traces"), ECVF_Cheat);
+TAutoConsoleVariable<int32> CVarPortalRecursionDepth(TEXT("sm.PortalRecursionDepth"), 2, TEXT("Number of portal-through-portal levels rendered by each portal (1 = no recursion)"), ECVF_Scalability);
+TAutoConsoleVariable<float> CVarPortalRecursionBudget(TEXT("sm.PortalRecursionBudget"), 2.0f, TEXT("Per frame budget in milliseconds for portal captures, recursion is cut short once exceeded (0 = unlimited)"), ECVF_Scalability);
+TAutoConsoleVariable<int32> CVarPortalRecursionFallback(TEXT("sm.PortalRecursionFallback"), 0, TEXT("What the deepest recursion level shows. 0: last good texture of the next level, 1: black"), ECVF_Scalability);
 
 APCharacter::APCharacter() : GunSocketName(FName(TEXT("GripPoint"))), CollisionChannel(ECC_WorldDynamic), TraceDistance(150.0f),
                              TraceRadius(15.0f), bIsGrabbingActor(false), bIsGrabbingThroughPortal(false), bReturnToOrientation(false)
@@ -160,100 +165,46 @@ void APCharacter::ReleaseActor()
 
 void APCharacter::FindActorToGrab()
 {
-	const bool bDrawDebug = CVarDebugDrawTrace.GetValueOnGameThread();
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalFindActorToGrab);
 
 	// Clear previous focus actor
 	FocusedActor = nullptr;
 	bIsGrabbingThroughPortal = false;
 
-	TArray<FHitResult> HitResults;
+	UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>();
+	if (PortalSubsystem == nullptr)
+		return;
 
-	FCollisionObjectQueryParams QueryParams;
-	QueryParams.AddObjectTypesToQuery(CollisionChannel);
-	QueryParams.AddObjectTypesToQuery(ECC_Portal);
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(CollisionChannel);
 
 	const FVector StartLocation = FirstPersonCameraComp->GetComponentLocation();
 	const FVector EndLocation = StartLocation + FirstPersonCameraComp->GetForwardVector() * TraceDistance;
-	const FCollisionShape ColShape = FCollisionShape::MakeSphere(TraceRadius);
 
-	const bool bBlockingHit = GetWorld()->SweepMultiByObjectType(HitResults, StartLocation, EndLocation, FQuat::Identity, QueryParams, ColShape);
+	// Trace through one portal so we can pick up the companion cube relative to the portal
+	FPortalTraceResult TraceResult;
+	PortalSubsystem->TraceThroughPortals(StartLocation, EndLocation, FCollisionShape::MakeSphere(TraceRadius), ObjectParams, FCollisionQueryParams::DefaultQueryParam, 1, TraceResult);
+	DrawPortalTrace(TraceResult);
 
-	if (bBlockingHit)
-	{
-		for (FHitResult Hit : HitResults)
-		{
-			if (bDrawDebug)
-			{
-				DrawDebugLine(GetWorld(), StartLocation, Hit.ImpactPoint, FColor::Green, false, 1.0f);
-				DrawDebugSphere(GetWorld(), Hit.ImpactPoint, TraceRadius, 32, FColor::Green, false, 0.0f);
-			}
-
-			AActor* HitActor = Hit.GetActor();
-			if (IsValid(HitActor))
-			{
-				// Trace through a portal so we can pick up the companion cube relative to the portal
-				APPortal* HitPortal = Cast<APPortal>(HitActor);
-				if (HitPortal && HitPortal->GetLinkedPortal() != nullptr)
-				{
-					if (FindActorToGrabThroughPortal(bDrawDebug, EndLocation, ColShape, Hit, HitPortal))
-						return;
-				}
-				else
-				{
-					FocusedActor = HitActor;
-					return;
-				}
-			}
-		}
-	}
-	else
+	AActor* HitActor = TraceResult.bBlockingHit ? TraceResult.Hit.GetActor() : nullptr;
+	if (IsValid(HitActor) == false)
+		return;
+
+	if (TraceResult.Portals.IsEmpty())
 	{
-		if (bDrawDebug)
-			DrawDebugLine(GetWorld(), StartLocation, EndLocation, FColor::Red, false, 1.0f);
+		FocusedActor = HitActor;
+		return;
 	}
-}
 
-bool APCharacter::FindActorToGrabThroughPortal(const bool bDrawDebug, const FVector& EndLocation, const FCollisionShape ColShape, const FHitResult& Hit, APPortal* HitPortal)
-{
-	const FVector NewStartLocation = UPPortalHelper::ConvertLocationToPortalSpace(Hit.ImpactPoint, HitPortal, HitPortal->GetLinkedPortal());
-	const FVector NewEndLocation = UPPortalHelper::ConvertLocationToPortalSpace(EndLocation, HitPortal, HitPortal->GetLinkedPortal());
+	// Only grab actors behind the portal, not the next portal
+	if (HitActor->IsA<APPortal>())
+		return;
 
-	FCollisionObjectQueryParams NewQueryParams;
-	NewQueryParams.AddObjectTypesToQuery(CollisionChannel);
+	FocusedActor = HitActor;
+	bIsGrabbingThroughPortal = true;
 
-	TArray<FHitResult> NewHitResults;
-	const bool bNewHit = GetWorld()->SweepMultiByObjectType(NewHitResults, NewStartLocation, NewEndLocation, FQuat::Identity, NewQueryParams, ColShape);
-	if (bNewHit)
-	{
-		for (FHitResult NewHit : NewHitResults)
-		{
-			AActor* NewHitActor = NewHit.GetActor();
-			if (IsValid(NewHitActor))
-			{
-				if (bDrawDebug)
-				{
-					DrawDebugLine(GetWorld(), NewStartLocation, NewHit.ImpactPoint, FColor::Green, false, 1.0f);
-					DrawDebugSphere(GetWorld(), NewHit.Location, TraceRadius, 32, FColor::Green, false, 0.0f);
-				}
-
-				FocusedActor = NewHitActor;
-				bIsGrabbingThroughPortal = true;
-
-				const USceneComponent* FocusedComp = NewHitActor->GetRootComponent();
-				const FVector GrabLocation = UPPortalHelper::ConvertLocationToPortalSpace(FocusedComp->GetComponentLocation(), HitPortal->GetLinkedPortal(), HitPortal);
-				GrabbedRelativeLocation = FirstPersonCameraComp->GetComponentTransform().InverseTransformPositionNoScale(GrabLocation);
-
-				return true;
-			}
-		}
-	}
-	else
-	{
-		if (bDrawDebug)
-			DrawDebugLine(GetWorld(), NewStartLocation, NewEndLocation, FColor::Red, false, 1.0f);
-	}
-
-	return false;
+	const FVector GrabLocation = TraceResult.SpaceTransform.InverseTransformPosition(HitActor->GetRootComponent()->GetComponentLocation());
+	GrabbedRelativeLocation = FirstPersonCameraComp->GetComponentTransform().InverseTransformPositionNoScale(GrabLocation);
 }
 
 void APCharacter::UpdateGrabbedActorPos()
@@ -262,25 +213,21 @@ void APCharacter::UpdateGrabbedActorPos()
 
 	if (bIsGrabbingThroughPortal)
 	{
-		FHitResult HitResult;
-	
-		FCollisionObjectQueryParams QueryParams;
-		QueryParams.AddObjectTypesToQuery(ECC_Portal);
-	
+		UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>();
+
 		FCollisionQueryParams CollisionQueryParams;
 		CollisionQueryParams.AddIgnoredActor(this);
 		CollisionQueryParams.AddIgnoredActor(PhysicsHandleComp->GetGrabbedComponent()->GetOwner());
-	
-		const bool bHit = GetWorld()->LineTraceSingleByObjectType(HitResult, FirstPersonCameraComp->GetComponentLocation(), NewLocation, QueryParams, CollisionQueryParams);
-		APPortal* HitPortal = Cast<APPortal>(HitResult.GetActor());
-		if (bHit && HitPortal && HitPortal->GetLinkedPortal() != nullptr)
-		{
-			const FVector Location = UPPortalHelper::ConvertLocationToPortalSpace(NewLocation, HitPortal, HitPortal->GetLinkedPortal());
-			PhysicsHandleComp->SetTargetLocation(Location);
-		}
-	
-		bIsGrabbingThroughPortal = bHit;
-		if (bHit == false) // We lost track of the object
+
+		// Portals are always queried, the trace only needs to find the one the grabbed actor is behind
+		FPortalTraceResult TraceResult;
+		if (PortalSubsystem)
+			PortalSubsystem->TraceThroughPortals(FirstPersonCameraComp->GetComponentLocation(), NewLocation, FCollisionShape::LineShape, FCollisionObjectQueryParams(), CollisionQueryParams, 1, TraceResult);
+
+		bIsGrabbingThroughPortal = TraceResult.Portals.Num() > 0;
+		if (bIsGrabbingThroughPortal)
+			PhysicsHandleComp->SetTargetLocation(TraceResult.SpaceTransform.TransformPosition(NewLocation));
+		else // We lost track of the object
 			ReleaseActor();
 	}
 	else
@@ -289,6 +236,19 @@ void APCharacter::UpdateGrabbedActorPos()
 	}
 }
 
+void APCharacter::DrawPortalTrace(const FPortalTraceResult& TraceResult) const
+{
+	if (CVarDebugDrawTrace.GetValueOnGameThread() == false)
+		return;
+
+	const FColor Color = TraceResult.bBlockingHit ? FColor::Green : FColor::Red;
+	for (const FPortalTraceSegment& Segment : TraceResult.Segments)
+		DrawDebugLine(GetWorld(), Segment.Start, Segment.End, Color, false, 1.0f);
+
+	if (TraceResult.bBlockingHit)
+		DrawDebugSphere(GetWorld(), TraceResult.Hit.Location, TraceRadius, 32, Color, false, 0.0f);
+}
+
 void APCharacter::OnPortalTeleport()
 {
 	OrientationReturnTimer = GetWorld()->GetTimeSeconds();
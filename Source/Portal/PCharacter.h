@@ -17,6 +17,7 @@ class UCameraComponent;
 class UInputAction;
 class UInputMappingContext;
 struct FInputActionValue;
+struct FPortalTraceResult;
 
 DECLARE_LOG_CATEGORY_EXTERN(LogPortalCharacter, Log, All);
 
@@ -56,8 +57,8 @@ protected:
 private:
 	void GrabActor();
 	void FindActorToGrab();
-	bool FindActorToGrabThroughPortal(bool bDrawDebug, const FVector& EndLocation, FCollisionShape ColShape, const FHitResult& Hit, APPortal* HitPortal);
 	void UpdateGrabbedActorPos();
+	void DrawPortalTrace(const FPortalTraceResult& TraceResult) const;
 
 	/** Pawn mesh: 1st person view (arms; seen only by self) */
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category= Mesh, meta = (AllowPrivateAccess = "true"))
@@ -3,9 +3,40 @@
 
 #include "PGameInstance.h"
 
+#include "MoviePlayer.h"
 #include "Blueprint/UserWidget.h"
+#include "Engine/AssetManager.h"
+#include "Level/PPortal.h"
 #include "MenuSystem/GameMenu.h"
 #include "MenuSystem/MainMenu.h"
+#include "ProfilingDebugging/MiscTrace.h"
+
+UPGameInstance::UPGameInstance() : GameplayMap(FSoftObjectPath(TEXT("/Game/Portal/Maps/PlaygroundMap.PlaygroundMap"))), MainMenuMap(FSoftObjectPath(TEXT("/Game/MenuSystem/MainMenuMap.MainMenuMap"))),
+                                   PreloadStartTime(0.0), PreloadDuration(0.0), PlayStartTime(0.0)
+{
+}
+
+void UPGameInstance::Init()
+{
+	Super::Init();
+
+	FCoreUObjectDelegates::PreLoadMap.AddUObject(this, &UPGameInstance::BeginLoadingScreen);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.AddUObject(this, &UPGameInstance::OnPostLoadMap);
+}
+
+void UPGameInstance::Shutdown()
+{
+	FCoreUObjectDelegates::PreLoadMap.RemoveAll(this);
+	FCoreUObjectDelegates::PostLoadMapWithWorld.RemoveAll(this);
+
+	if (PreloadHandle.IsValid())
+	{
+		PreloadHandle->CancelHandle();
+		PreloadHandle.Reset();
+	}
+
+	Super::Shutdown();
+}
 
 void UPGameInstance::LoadMainMenuWidget(const TSubclassOf<UUserWidget> MainMenuClass)
 {
@@ -19,6 +50,9 @@ void UPGameInstance::LoadMainMenuWidget(const TSubclassOf<UUserWidget> MainMenuC
 	
 	MainMenu->Setup();
 	MainMenu->SetMenuInterface(this);
+
+	// The player reads the menu while the gameplay map loads
+	StartPreload();
 }
 
 void UPGameInstance::LoadGameMenuWidget(const TSubclassOf<UUserWidget> GameMenuClass)
@@ -39,12 +73,10 @@ void UPGameInstance::PlayGame()
 {
 	if (MainMenu != nullptr)
 		MainMenu->TearDown();
-	
-	APlayerController* PlayerController = GetFirstLocalPlayerController();
-	if (ensure(PlayerController != nullptr) == false)
-		return;
-	
-	PlayerController->ClientTravel("/Game/Portal/Maps/PlaygroundMap", TRAVEL_Absolute);
+
+	StartPreload();
+	PlayStartTime = FPlatformTime::Seconds();
+	TravelToMap(GameplayMap);
 }
 
 void UPGameInstance::LoadMainMenu()
@@ -52,18 +84,107 @@ void UPGameInstance::LoadMainMenu()
 	if (GameMenu != nullptr)
 		GameMenu->TearDown();
 
+	TravelToMap(MainMenuMap);
+}
+
+void UPGameInstance::QuitGame()
+{
 	APlayerController* PlayerController = GetFirstLocalPlayerController();
 	if (ensure(PlayerController != nullptr) == false)
 		return;
-	
-	PlayerController->ClientTravel("/Game/MenuSystem/MainMenuMap", TRAVEL_Absolute);
+
+	PlayerController->ConsoleCommand("quit");
 }
 
-void UPGameInstance::QuitGame()
+void UPGameInstance::StartPreload()
 {
+	if (PreloadHandle.IsValid() || GameplayMap.IsNull())
+		return;
+
+	TArray<FSoftObjectPath> AssetsToLoad = PreloadAssets;
+	AssetsToLoad.Add(GameplayMap.ToSoftObjectPath());
+	if (LoadingScreenClass.IsNull() == false)
+		AssetsToLoad.Add(LoadingScreenClass.ToSoftObjectPath());
+
+	PreloadStartTime = FPlatformTime::Seconds();
+	PreloadDuration = 0.0;
+	PreloadHandle = UAssetManager::GetStreamableManager().RequestAsyncLoad(AssetsToLoad, FStreamableDelegate::CreateUObject(this, &UPGameInstance::OnPreloadCompleted),
+	                                                                      FStreamableManager::AsyncLoadHighPriority);
+}
+
+void UPGameInstance::OnPreloadCompleted()
+{
+	PreloadDuration = FPlatformTime::Seconds() - PreloadStartTime;
+	UE_LOG(LogPortal, Log, TEXT("Preloaded '%s' and %d assets in %.2f s."), *GameplayMap.GetLongPackageName(), PreloadAssets.Num(), PreloadDuration);
+}
+
+void UPGameInstance::TravelToMap(const TSoftObjectPtr<UWorld>& Map)
+{
+	UWorld* World = GetWorld();
+	if (ensure(World != nullptr && Map.IsNull() == false) == false)
+		return;
+
+	const FString MapName = Map.GetLongPackageName();
+	BeginLoadingScreen(MapName);
+
+	// Seamless travel loads the map asynchronously while a transition world keeps ticking, it isn't supported in PIE
+	if (World->IsPlayInEditor() == false)
+	{
+		World->SeamlessTravel(MapName, true);
+		return;
+	}
+
 	APlayerController* PlayerController = GetFirstLocalPlayerController();
 	if (ensure(PlayerController != nullptr) == false)
 		return;
 
-	PlayerController->ConsoleCommand("quit");
+	PlayerController->ClientTravel(MapName, TRAVEL_Absolute);
+}
+
+void UPGameInstance::BeginLoadingScreen(const FString& MapName)
+{
+	if (IsRunningDedicatedServer() || IsMoviePlayerEnabled() == false || GetMoviePlayer()->IsMovieCurrentlyPlaying())
+		return;
+
+	if (LoadingScreen == nullptr && LoadingScreenClass.IsNull() == false)
+	{
+		if (const TSubclassOf<UUserWidget> WidgetClass = LoadingScreenClass.LoadSynchronous())
+			LoadingScreen = CreateWidget<UUserWidget>(this, WidgetClass);
+	}
+
+	// Drawn on the loading thread, it keeps animating during blocking loads and lets the engine tick during seamless travel
+	FLoadingScreenAttributes Attributes;
+	Attributes.bAutoCompleteWhenLoadingCompletes = true;
+	Attributes.bAllowEngineTick = true;
+	Attributes.WidgetLoadingScreen = LoadingScreen ? LoadingScreen->TakeWidget() : FLoadingScreenAttributes::NewTestLoadingScreenWidget();
+
+	GetMoviePlayer()->SetupLoadingScreen(Attributes);
+	GetMoviePlayer()->PlayMovie();
+}
+
+void UPGameInstance::OnPostLoadMap(UWorld* LoadedWorld)
+{
+	if (IsMoviePlayerEnabled() && GetMoviePlayer()->IsMovieCurrentlyPlaying())
+		GetMoviePlayer()->StopMovie();
+
+	if (LoadedWorld == nullptr || UWorld::RemovePIEPrefix(LoadedWorld->GetOutermost()->GetName()) != GameplayMap.GetLongPackageName())
+		return;
+
+	// The engine owns the gameplay world now, holding on to it would keep it alive after the next travel
+	const bool bWasPreloaded = PreloadHandle.IsValid() && PreloadHandle->HasLoadCompleted();
+	if (PreloadHandle.IsValid())
+	{
+		PreloadHandle->ReleaseHandle();
+		PreloadHandle.Reset();
+	}
+
+	if (PlayStartTime <= 0.0)
+		return;
+
+	const double TravelDuration = FPlatformTime::Seconds() - PlayStartTime;
+	PlayStartTime = 0.0;
+
+	TRACE_BOOKMARK(TEXT("Gameplay map loaded"));
+	UE_LOG(LogPortal, Display, TEXT("Main menu to gameplay in %.2f s, the gameplay map was %s."), TravelDuration,
+	       bWasPreloaded ? *FString::Printf(TEXT("preloaded in %.2f s"), PreloadDuration) : TEXT("still loading"));
 }
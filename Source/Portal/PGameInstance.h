@@ -5,20 +5,28 @@
 #include "CoreMinimal.h"
 #include "Engine/GameInstance.h"
 #include "MenuSystem/MenuInterface.h"
+#include "UObject/SoftObjectPtr.h"
 #include "PGameInstance.generated.h"
 
 class UGameMenu;
 class UMainMenu;
+struct FStreamableHandle;
 
 /**
- * 
+ * Menus and level travel. The gameplay map and its portal assets are async loaded while the main menu is shown,
+ * travel is seamless behind a loading screen drawn on the loading thread, and the menu to gameplay time is logged.
  */
-UCLASS()
+UCLASS(config=Game)
 class PORTAL_API UPGameInstance : public UGameInstance, public IMenuInterface
 {
 	GENERATED_BODY()
 
 public:
+	UPGameInstance();
+
+	virtual void Init() override;
+	virtual void Shutdown() override;
+
 	UFUNCTION(BlueprintCallable)
 	void LoadMainMenuWidget(TSubclassOf<UUserWidget> MainMenuClass);
 
@@ -35,6 +43,41 @@ public:
 	virtual void QuitGame() override;
 
 private:
+	/* Start loading the gameplay map and the preload assets in the background, does nothing if already started. */
+	void StartPreload();
+	void OnPreloadCompleted();
+
+	void TravelToMap(const TSoftObjectPtr<UWorld>& Map);
+
+	void BeginLoadingScreen(const FString& MapName);
+	void OnPostLoadMap(UWorld* LoadedWorld);
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UWorld> GameplayMap;
+
+	UPROPERTY(Config)
+	TSoftObjectPtr<UWorld> MainMenuMap;
+
+	/* Portal classes and other assets of the gameplay map loaded with it. */
+	UPROPERTY(Config)
+	TArray<FSoftObjectPath> PreloadAssets;
+
+	/* Widget drawn during travel, the engine test loading screen if unset. */
+	UPROPERTY(Config)
+	TSoftClassPtr<UUserWidget> LoadingScreenClass;
+
+	UPROPERTY()
+	TObjectPtr<UUserWidget> LoadingScreen;
+
+	/* Keeps the preloaded map and assets in memory until the gameplay map is loaded. */
+	TSharedPtr<FStreamableHandle> PreloadHandle;
+
+	double PreloadStartTime;
+	double PreloadDuration;
+
+	/* Time the player pressed play, zero outside of a menu to gameplay travel. */
+	double PlayStartTime;
+
 	UPROPERTY()
 	TObjectPtr<UMainMenu> MainMenu;
 
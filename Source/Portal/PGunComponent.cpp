@@ -3,6 +3,7 @@
 
 #include "PGunComponent.h"
 #include "PCharacter.h"
+#include "Portal.h"
 #include "GameFramework/PlayerController.h"
 #include "Camera/PlayerCameraManager.h"
 #include "Kismet/GameplayStatics.h"
@@ -16,6 +17,8 @@
 #include "Level/PGhostPortalBorder.h"
 #include "Level/PPortal.h"
 #include "Level/PPortalWall.h"
+#include "Subsystems/PPortalSubsystem.h"
+#include "Subsystems/PPortalWallSubsystem.h"
 
 UPGunComponent::UPGunComponent() : PortalWallChannel(ECC_WorldStatic), MaxPortalDistance(10000.0f), GhostBorder(nullptr)
 {
@@ -44,6 +47,8 @@ void UPGunComponent::Init(APCharacter* TargetCharacter)
 
 void UPGunComponent::Fire(const bool bIsLeftPortal)
 {
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalGunFire);
+
 	if (OwningCharacter == nullptr || OwningCharacter->GetController() == nullptr)
 		return;
 
@@ -70,37 +75,37 @@ void UPGunComponent::Fire(const bool bIsLeftPortal)
 		return;
 
 	const FVector StartLocation = CameraComp->GetComponentLocation();
-	const FVector EndLocation = StartLocation + CameraComp->GetForwardVector() * MaxPortalDistance;
-
-
-	FHitResult HitResult;
+	const FVector Direction = CameraComp->GetForwardVector();
 
-	const bool bBlockingHit = GetWorld()->LineTraceSingleByChannel(HitResult, StartLocation, EndLocation, ECC_Visibility);
-	if (bBlockingHit == false)
-		return;
-
-	AActor* HitActor = HitResult.GetActor();
-	if (IsValid(HitActor) == false)
-		return;
+	// Find the portal wall in the registry first, then make sure nothing else stands in front of it with a cheap test trace
+	FPortalWallHit HitResult;
+	UPPortalWallSubsystem* WallSubsystem = GetWorld()->GetSubsystem<UPPortalWallSubsystem>();
+	bool bHitWall = WallSubsystem && WallSubsystem->RaycastWalls(StartLocation, Direction, MaxPortalDistance, HitResult);
+	if (bHitWall)
+	{
+		FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(PortalGunConfirm), false, OwningCharacter);
+		QueryParams.AddIgnoredActor(HitResult.Wall);
+		bHitWall = GetWorld()->LineTraceTestByChannel(StartLocation, HitResult.Location - Direction, ECC_Visibility, QueryParams) == false;
+	}
 
-	APPortalWall* PortalWall = Cast<APPortalWall>(HitActor);
+	APPortalWall* PortalWall = bHitWall ? HitResult.Wall : nullptr;
 	if (PortalWall != nullptr)
 	{
-		const float DotProduct = FVector::DotProduct(HitResult.ImpactNormal, OwningCharacter->GetActorUpVector());
+		const float DotProduct = FVector::DotProduct(HitResult.Normal, OwningCharacter->GetActorUpVector());
 		const bool bIsFloorOrCeiling = FMath::Abs(DotProduct) > OwningCharacter->GetWalkableFloorCos();
 		FRotator Rotation;
 		if (bIsFloorOrCeiling)
 		{
-			const FMatrix RotationMatrix = FRotationMatrix::MakeFromXZ(HitResult.ImpactNormal, OwningCharacter->GetActorForwardVector());
+			const FMatrix RotationMatrix = FRotationMatrix::MakeFromXZ(HitResult.Normal, OwningCharacter->GetActorForwardVector());
 			Rotation = RotationMatrix.Rotator();
 		}
 		else
 		{
-			const FMatrix RotationMatrix = FRotationMatrix::MakeFromX(HitResult.ImpactNormal);
+			const FMatrix RotationMatrix = FRotationMatrix::MakeFromX(HitResult.Normal);
 			Rotation = RotationMatrix.Rotator();
 		}
 
-		const FVector Origin = HitResult.Location + HitResult.ImpactNormal;
+		const FVector Origin = HitResult.Location + HitResult.Normal;
 
 		if (GhostBorder == nullptr)
 		{
@@ -163,7 +168,7 @@ void UPGunComponent::SpawnPortal(APPortalWall* PortalWall, const UE::Math::TRota
 		else
 			UpdatePortalTransform(LeftPortal, PortalLocation, Rotation);
 
-		FinalizePortalSetup(LeftPortal, PortalExtents, PortalWall, bIsFloorPortal);
+		LeftPortal->PlaceOnWall(PortalWall, PortalExtents, bIsFloorPortal);
 	}
 	else
 	{
@@ -172,13 +177,16 @@ void UPGunComponent::SpawnPortal(APPortalWall* PortalWall, const UE::Math::TRota
 		else
 			UpdatePortalTransform(RightPortal, PortalLocation, Rotation);
 
-		FinalizePortalSetup(RightPortal, PortalExtents, PortalWall, bIsFloorPortal);
+		RightPortal->PlaceOnWall(PortalWall, PortalExtents, bIsFloorPortal);
 	}
 
-	if (LeftPortal)
+	// The gun portals are one pair of the portal graph, a lone portal shows its default material until the other one is placed
+	UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>();
+	if (LeftPortal && RightPortal && PortalSubsystem)
+		PortalSubsystem->LinkPortals(LeftPortal, RightPortal);
+	else if (LeftPortal)
 		LeftPortal->LinkPortal(RightPortal);
-
-	if (RightPortal)
+	else if (RightPortal)
 		RightPortal->LinkPortal(LeftPortal);
 }
 
@@ -201,36 +209,9 @@ void UPGunComponent::UpdatePortalTransform(APPortal* Portal, const FVector& Port
 	Portal->SetActorLocation(PortalLocation);
 }
 
-void UPGunComponent::FinalizePortalSetup(APPortal* Portal, const FVector2D& PortalExtents, APPortalWall* PortalWall, bool bIsFloorPortal)
-{
-	Portal->CurrentWall = PortalWall;
-	Portal->Extents = PortalExtents;
-	Portal->UpdatePortalBorderCollision(bIsFloorPortal);
-	Portal->OnPortalSpawned();
-}
-
 bool UPGunComponent::IsPortalPlacementValid(const APPortalWall* PortalWall, const bool bIsLeftPortal, const FVector& PortalLocation, const FVector2D& PortalExtents) const
 {
-	if (bIsLeftPortal)
-	{
-		if (RightPortal && RightPortal->CurrentWall == PortalWall)
-		{
-			const auto RightPortalRelativeLocation = PortalWall->GetTransform().InverseTransformPosition(RightPortal->GetActorLocation());
-			const auto LeftPortalRelativeLocation = PortalWall->GetTransform().InverseTransformPosition(PortalLocation);
-			return UPPortalHelper::IsPortalColliding(RightPortalRelativeLocation, RightPortal->Extents, LeftPortalRelativeLocation, PortalExtents) == false;
-		}
-	}
-	else
-	{
-		if (LeftPortal && LeftPortal->CurrentWall == PortalWall)
-		{
-			const auto LeftPortalRelativeLocation = PortalWall->GetTransform().InverseTransformPosition(LeftPortal->GetActorLocation());
-			const auto RightPortalRelativeLocation = PortalWall->GetTransform().InverseTransformPosition(PortalLocation);
-			return UPPortalHelper::IsPortalColliding(LeftPortalRelativeLocation, LeftPortal->Extents, RightPortalRelativeLocation, PortalExtents) == false;
-		}
-	}
-
-	return true;
+	return UPPortalHelper::IsPortalPlacementClear(bIsLeftPortal ? RightPortal : LeftPortal, PortalWall, PortalLocation, PortalExtents);
 }
 
 void UPGunComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
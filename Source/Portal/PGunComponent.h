@@ -23,6 +23,8 @@ public:
 
 	void Init(APCharacter* TargetCharacter);
 
+	TSubclassOf<APPortal> GetPortalClass() const { return PortalClass; }
+
 protected:
 	UFUNCTION()
 	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
@@ -39,7 +41,6 @@ private:
 	void SpawnPortal(APPortalWall* PortalWall, const UE::Math::TRotator<double>& Rotation, const FVector& PortalLocation, const FVector2D& PortalExtents, bool bIsLeftPortal, bool bIsFloorPortal);
 	APPortal* SpawnAndInitializePortal(APPortalWall* PortalWall, const UE::Math::TRotator<double>& Rotation, const FVector& PortalLocation, bool bIsLeftPortal) const;
 	void UpdatePortalTransform(APPortal* Portal, const FVector& PortalLocation, const UE::Math::TRotator<double>& Rotation);
-	void FinalizePortalSetup(APPortal* Portal, const FVector2D& PortalExtents, APPortalWall* PortalWall, bool bIsFloorPortal);
 
 	bool IsPortalPlacementValid(const APPortalWall* PortalWall, bool bIsLeftPortal, const FVector& PortalLocation, const FVector2D& PortalExtents) const;
 	
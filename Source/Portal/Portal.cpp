@@ -4,4 +4,23 @@
 #include "Modules/ModuleManager.h"
 
 IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, Portal, "Portal" );
- 
\ No newline at end of file
+
+DEFINE_STAT(STAT_PortalCapturePortals);
+DEFINE_STAT(STAT_PortalTickView);
+DEFINE_STAT(STAT_PortalUpdateView);
+DEFINE_STAT(STAT_PortalCaptureScene);
+DEFINE_STAT(STAT_PortalClearView);
+DEFINE_STAT(STAT_PortalPostPhysicsTick);
+DEFINE_STAT(STAT_PortalUpdateTrackedActors);
+DEFINE_STAT(STAT_PortalTeleportActor);
+DEFINE_STAT(STAT_PortalCopyActor);
+DEFINE_STAT(STAT_PortalDeleteCopy);
+DEFINE_STAT(STAT_PortalGunFire);
+DEFINE_STAT(STAT_PortalFindActorToGrab);
+
+DEFINE_STAT(STAT_PortalTrackedActors);
+DEFINE_STAT(STAT_PortalLiveCopies);
+DEFINE_STAT(STAT_PortalTeleportsPerSecond);
+DEFINE_STAT(STAT_PortalRenderTargetMemory);
+
+UE_TRACE_CHANNEL_DEFINE(PortalChannel);
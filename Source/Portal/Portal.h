@@ -3,3 +3,35 @@
 #pragma once
 
 #include "CoreMinimal.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+#include "Stats/Stats.h"
+#include "Trace/Trace.h"
+
+/* Portal hot paths, shown in game with 'stat portal'. */
+DECLARE_STATS_GROUP(TEXT("Portal"), STATGROUP_Portal, STATCAT_Advanced);
+
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Capture Portals"), STAT_PortalCapturePortals, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Tick Portal View"), STAT_PortalTickView, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Portal View"), STAT_PortalUpdateView, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Capture Scene"), STAT_PortalCaptureScene, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Clear Portal View"), STAT_PortalClearView, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Post Physics Tick"), STAT_PortalPostPhysicsTick, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Update Tracked Actors"), STAT_PortalUpdateTrackedActors, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Teleport Actor"), STAT_PortalTeleportActor, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Copy Actor"), STAT_PortalCopyActor, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Delete Copy"), STAT_PortalDeleteCopy, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Gun Fire"), STAT_PortalGunFire, STATGROUP_Portal, PORTAL_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("Find Actor To Grab"), STAT_PortalFindActorToGrab, STATGROUP_Portal, PORTAL_API);
+
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Tracked Actors"), STAT_PortalTrackedActors, STATGROUP_Portal, PORTAL_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Live Copies"), STAT_PortalLiveCopies, STATGROUP_Portal, PORTAL_API);
+DECLARE_FLOAT_ACCUMULATOR_STAT_EXTERN(TEXT("Teleports Per Second"), STAT_PortalTeleportsPerSecond, STATGROUP_Portal, PORTAL_API);
+DECLARE_MEMORY_STAT_EXTERN(TEXT("Render Target Memory"), STAT_PortalRenderTargetMemory, STATGROUP_Portal, PORTAL_API);
+
+/* Insights channel of the portal CPU events, record it with -trace=cpu,portal. */
+UE_TRACE_CHANNEL_EXTERN(PortalChannel, PORTAL_API);
+
+/* Cycle counter for 'stat portal' and CPU event on the portal trace channel, both named after the stat. */
+#define PORTAL_SCOPE_CYCLE_COUNTER(Stat) \
+	SCOPE_CYCLE_COUNTER(Stat); \
+	TRACE_CPUPROFILER_EVENT_SCOPE_ON_CHANNEL_STR(#Stat, PortalChannel)
@@ -0,0 +1,406 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PInputReplaySubsystem.h"
+
+#include "EnhancedInputComponent.h"
+#include "EnhancedInputSubsystems.h"
+#include "EnhancedPlayerInput.h"
+#include "InputAction.h"
+#include "Engine/LocalPlayer.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformProcess.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Portal/Level/PPortal.h"
+#include "Portal/Subsystems/PPortalSubsystem.h"
+
+/* 'PINP', followed by the format version. */
+static constexpr uint32 RecordingMagic = 0x504E4950;
+static constexpr uint16 RecordingVersion = 1;
+
+void UPInputReplaySubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	MapName = UWorld::RemovePIEPrefix(InWorld.GetMapName());
+
+	FString FileName;
+	if (FParse::Value(FCommandLine::Get(), TEXT("PortalReplay="), FileName))
+	{
+		RecordingPath = GetRecordingPath(FileName);
+		if (LoadRecording(RecordingPath) == false)
+			return;
+
+		// Every run steps the simulation the same way, and doesn't wait for real time between frames
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(FixedDeltaTime);
+		Mode = EInputReplayMode::Replaying;
+	}
+	else if (FParse::Value(FCommandLine::Get(), TEXT("PortalRecord="), FileName))
+	{
+		RecordingPath = GetRecordingPath(FileName);
+
+		// Record with the step the replay uses, so frame N of the replay is simulated like frame N was while recording
+		FApp::SetUseFixedTimeStep(true);
+		FApp::SetFixedDeltaTime(FixedDeltaTime);
+		Mode = EInputReplayMode::Recording;
+	}
+	else
+	{
+		return;
+	}
+
+	UE_LOG(LogPortal, Log, TEXT("%s input '%s' on %s"), IsReplaying() ? TEXT("Replaying") : TEXT("Recording"), *RecordingPath, *MapName);
+}
+
+void UPInputReplaySubsystem::Deinitialize()
+{
+	if (IsRecording())
+	{
+		if (SaveRecording(RecordingPath))
+			UE_LOG(LogPortal, Log, TEXT("Input recording of %u frames saved to '%s'"), FrameIndex, *RecordingPath);
+		else
+			UE_LOG(LogPortal, Error, TEXT("Failed to save the input recording '%s'."), *RecordingPath);
+	}
+	else if (IsReplaying())
+	{
+		// The world ended before the recording did, keep what was measured
+		FinishReplay();
+	}
+
+	Mode = EInputReplayMode::None;
+
+	Super::Deinitialize();
+}
+
+void UPInputReplaySubsystem::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (Mode == EInputReplayMode::None)
+		return;
+
+	// Frames are counted from the first one the player can act on, for both recording and replay
+	if (bActionsBound == false)
+	{
+		if (GatherBoundActions() == false)
+			return;
+
+		bActionsBound = true;
+		StartTime = FPlatformTime::Seconds();
+		LastFrameTime = StartTime;
+	}
+
+	if (IsRecording())
+	{
+		RecordFrame();
+
+		// A fixed timestep doesn't wait for real time, hold the frame so the player still plays at the recorded speed
+		const double WaitTime = StartTime + FrameIndex * FixedDeltaTime - FPlatformTime::Seconds();
+		if (WaitTime > 0.0)
+			FPlatformProcess::SleepNoStats(static_cast<float>(WaitTime));
+	}
+	else
+	{
+		ReplayFrame();
+	}
+}
+
+TStatId UPInputReplaySubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UPInputReplaySubsystem, STATGROUP_Tickables);
+}
+
+bool UPInputReplaySubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+bool UPInputReplaySubsystem::GatherBoundActions()
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController == nullptr || PlayerController->GetPawn() == nullptr)
+		return false;
+
+	// The character binds its actions on the pawn input component, the gun on the player controller one
+	TArray<const UInputAction*> BoundActions;
+	for (const UInputComponent* InputComponent : { PlayerController->GetPawn()->InputComponent.Get(), PlayerController->InputComponent.Get() })
+	{
+		const UEnhancedInputComponent* EnhancedInputComponent = Cast<UEnhancedInputComponent>(InputComponent);
+		if (EnhancedInputComponent == nullptr)
+			continue;
+
+		for (const TUniquePtr<FEnhancedInputActionEventBinding>& Binding : EnhancedInputComponent->GetActionEventBindings())
+		{
+			if (Binding->GetAction() != nullptr)
+				BoundActions.AddUnique(Binding->GetAction());
+		}
+	}
+
+	if (BoundActions.Num() == 0)
+		return false;
+
+	if (IsRecording())
+	{
+		Actions = BoundActions.Num() > MAX_uint8 ? TArray<const UInputAction*>(BoundActions.GetData(), MAX_uint8) : BoundActions;
+		for (const UInputAction* Action : Actions)
+			ActionPaths.Add(Action->GetPathName());
+	}
+	else
+	{
+		// Recorded actions are matched by asset path, the order of the bindings may have changed since
+		Actions.Reset();
+		for (const FString& ActionPath : ActionPaths)
+		{
+			const UInputAction* const* BoundAction = BoundActions.FindByPredicate([&ActionPath](const UInputAction* Action) { return Action->GetPathName() == ActionPath; });
+			Actions.Add(BoundAction ? *BoundAction : nullptr);
+
+			if (BoundAction == nullptr)
+				UE_LOG(LogPortal, Warning, TEXT("Recorded input action '%s' isn't bound anymore, it won't be replayed."), *ActionPath);
+		}
+	}
+
+	CurrentValues.SetNum(Actions.Num());
+	return true;
+}
+
+void UPInputReplaySubsystem::RecordFrame()
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	const UEnhancedInputLocalPlayerSubsystem* InputSubsystem = PlayerController ? ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer()) : nullptr;
+	const UEnhancedPlayerInput* PlayerInput = InputSubsystem ? InputSubsystem->GetPlayerInput() : nullptr;
+	if (PlayerInput == nullptr)
+		return;
+
+	// Only what changed since the last frame is written, a held key or a still mouse costs nothing
+	FRecordedInputFrame Frame;
+	Frame.FrameIndex = FrameIndex;
+	Frame.Time = static_cast<float>(FPlatformTime::Seconds() - StartTime);
+	for (int32 i = 0; i < Actions.Num(); i++)
+	{
+		const FInputActionValue Value = PlayerInput->GetActionValue(Actions[i]);
+		if (Value.Get<FVector>() == CurrentValues[i].Get<FVector>())
+			continue;
+
+		CurrentValues[i] = Value;
+		Frame.Changes.Emplace(static_cast<uint8>(i), Value);
+	}
+
+	if (Frame.Changes.Num() > 0)
+		Frames.Add(MoveTemp(Frame));
+
+	FrameIndex++;
+}
+
+void UPInputReplaySubsystem::ReplayFrame()
+{
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	UEnhancedInputLocalPlayerSubsystem* InputSubsystem = PlayerController ? ULocalPlayer::GetSubsystem<UEnhancedInputLocalPlayerSubsystem>(PlayerController->GetLocalPlayer()) : nullptr;
+	if (InputSubsystem == nullptr)
+		return;
+
+	// Injected input is processed on the next frame, feed it the values recorded for that frame
+	while (ReplayCursor < Frames.Num() && Frames[ReplayCursor].FrameIndex <= FrameIndex + 1)
+	{
+		for (const TPair<uint8, FInputActionValue>& Change : Frames[ReplayCursor].Changes)
+		{
+			if (CurrentValues.IsValidIndex(Change.Key))
+				CurrentValues[Change.Key] = Change.Value;
+		}
+
+		ReplayCursor++;
+	}
+
+	// Injected values only last one frame, held actions are injected again every frame
+	for (int32 i = 0; i < Actions.Num(); i++)
+	{
+		if (Actions[i] != nullptr && CurrentValues[i].IsNonZero())
+			InputSubsystem->InjectInputForAction(Actions[i], CurrentValues[i], {}, {});
+	}
+
+	const double Now = FPlatformTime::Seconds();
+	FInputReplayFrameStats& Stats = FrameStats.AddDefaulted_GetRef();
+	Stats.FrameTimeMs = static_cast<float>((Now - LastFrameTime) * 1000.0);
+	LastFrameTime = Now;
+
+	if (const UPPortalSubsystem* PortalSubsystem = GetWorld()->GetSubsystem<UPPortalSubsystem>())
+	{
+		Stats.Captures = PortalSubsystem->GetNumCaptures() - LastNumCaptures;
+		Stats.Teleports = PortalSubsystem->GetNumTeleports() - LastNumTeleports;
+		LastNumCaptures = PortalSubsystem->GetNumCaptures();
+		LastNumTeleports = PortalSubsystem->GetNumTeleports();
+
+		for (const APPortal* Portal : PortalSubsystem->GetPortals())
+		{
+			if (IsValid(Portal))
+				Stats.TrackedActors += Portal->GetTrackedActors().Num();
+		}
+	}
+
+	FrameIndex++;
+	if (FrameIndex >= NumFrames)
+		FinishReplay();
+}
+
+void UPInputReplaySubsystem::FinishReplay()
+{
+	Mode = EInputReplayMode::None;
+
+	if (FrameStats.Num() == 0)
+		return;
+
+	double TotalFrameTimeMs = 0.0;
+	float MaxFrameTimeMs = 0.0f;
+	for (const FInputReplayFrameStats& Stats : FrameStats)
+	{
+		TotalFrameTimeMs += Stats.FrameTimeMs;
+		MaxFrameTimeMs = FMath::Max(MaxFrameTimeMs, Stats.FrameTimeMs);
+	}
+
+	const FString StatsPath = FPaths::ProjectSavedDir() / TEXT("Benchmarks") / FPaths::GetBaseFilename(RecordingPath) + TEXT("-Replay.csv");
+	if (SaveReplayStats(StatsPath))
+		UE_LOG(LogPortal, Display, TEXT("Replayed %d frames, average %.3f ms, max %.3f ms, per frame stats saved to '%s'"), FrameStats.Num(), TotalFrameTimeMs / FrameStats.Num(), MaxFrameTimeMs, *StatsPath);
+	else
+		UE_LOG(LogPortal, Error, TEXT("Failed to save the replay stats '%s'."), *StatsPath);
+
+	FrameStats.Reset();
+
+	if (FApp::IsUnattended())
+		FPlatformMisc::RequestExit(false, TEXT("PortalReplay"));
+}
+
+bool UPInputReplaySubsystem::SaveRecording(const FString& Path) const
+{
+	TArray<uint8> Data;
+	FMemoryWriter Writer(Data);
+
+	uint32 Magic = RecordingMagic;
+	uint16 Version = RecordingVersion;
+	FString RecordedMapName = MapName;
+	float Step = FixedDeltaTime;
+	uint32 RecordedFrames = FrameIndex;
+	TArray<FString> RecordedActionPaths = ActionPaths;
+	int32 NumChangedFrames = Frames.Num();
+	Writer << Magic << Version << RecordedMapName << Step << RecordedFrames << RecordedActionPaths << NumChangedFrames;
+
+	for (const FRecordedInputFrame& Frame : Frames)
+	{
+		uint32 Index = Frame.FrameIndex;
+		float Time = Frame.Time;
+		uint8 NumChanges = static_cast<uint8>(Frame.Changes.Num());
+		Writer << Index << Time << NumChanges;
+
+		// Only the axes the value type uses
+		for (const TPair<uint8, FInputActionValue>& Change : Frame.Changes)
+		{
+			uint8 ActionIndex = Change.Key;
+			uint8 ValueType = static_cast<uint8>(Change.Value.GetValueType());
+			FVector3f Axes(Change.Value.Get<FVector>());
+			Writer << ActionIndex << ValueType;
+
+			for (int32 Axis = 0; Axis < GetNumAxes(Change.Value.GetValueType()); Axis++)
+				Writer << Axes[Axis];
+		}
+	}
+
+	return FFileHelper::SaveArrayToFile(Data, *Path);
+}
+
+bool UPInputReplaySubsystem::LoadRecording(const FString& Path)
+{
+	TArray<uint8> Data;
+	if (FFileHelper::LoadFileToArray(Data, *Path) == false)
+	{
+		UE_LOG(LogPortal, Error, TEXT("Failed to read the input recording '%s'."), *Path);
+		return false;
+	}
+
+	FMemoryReader Reader(Data);
+
+	uint32 Magic = 0;
+	uint16 Version = 0;
+	Reader << Magic << Version;
+	if (Magic != RecordingMagic || Version != RecordingVersion)
+	{
+		UE_LOG(LogPortal, Error, TEXT("'%s' isn't an input recording of this version."), *Path);
+		return false;
+	}
+
+	FString RecordedMapName;
+	int32 NumChangedFrames = 0;
+	Reader << RecordedMapName << FixedDeltaTime << NumFrames << ActionPaths << NumChangedFrames;
+	if (RecordedMapName != MapName)
+	{
+		UE_LOG(LogPortal, Error, TEXT("Input recording '%s' was made on %s, not %s."), *Path, *RecordedMapName, *MapName);
+		return false;
+	}
+
+	Frames.Reset(NumChangedFrames);
+	for (int32 i = 0; i < NumChangedFrames && Reader.IsError() == false; i++)
+	{
+		FRecordedInputFrame& Frame = Frames.AddDefaulted_GetRef();
+		uint8 NumChanges = 0;
+		Reader << Frame.FrameIndex << Frame.Time << NumChanges;
+
+		for (int32 Change = 0; Change < NumChanges; Change++)
+		{
+			uint8 ActionIndex = 0;
+			uint8 ValueType = 0;
+			FVector3f Axes = FVector3f::ZeroVector;
+			Reader << ActionIndex << ValueType;
+
+			const EInputActionValueType Type = static_cast<EInputActionValueType>(FMath::Min<uint8>(ValueType, static_cast<uint8>(EInputActionValueType::Axis3D)));
+			for (int32 Axis = 0; Axis < GetNumAxes(Type); Axis++)
+				Reader << Axes[Axis];
+
+			Frame.Changes.Emplace(ActionIndex, FInputActionValue(Type, FVector(Axes)));
+		}
+	}
+
+	if (Reader.IsError())
+	{
+		UE_LOG(LogPortal, Error, TEXT("Input recording '%s' is truncated."), *Path);
+		return false;
+	}
+
+	return true;
+}
+
+bool UPInputReplaySubsystem::SaveReplayStats(const FString& Path) const
+{
+	FString Csv = TEXT("Frame,FrameTimeMs,Captures,Teleports,TrackedActors\n");
+	for (int32 i = 0; i < FrameStats.Num(); i++)
+	{
+		const FInputReplayFrameStats& Stats = FrameStats[i];
+		Csv += FString::Printf(TEXT("%d,%.4f,%u,%u,%d\n"), i, Stats.FrameTimeMs, Stats.Captures, Stats.Teleports, Stats.TrackedActors);
+	}
+
+	return FFileHelper::SaveStringToFile(Csv, *Path);
+}
+
+FString UPInputReplaySubsystem::GetRecordingPath(const FString& Name)
+{
+	if (FPaths::IsRelative(Name) == false || Name.Contains(TEXT("/")) || Name.Contains(TEXT("\\")))
+		return Name;
+
+	return FPaths::ProjectSavedDir() / TEXT("InputRecordings") / FPaths::SetExtension(Name, TEXT("pinput"));
+}
+
+int32 UPInputReplaySubsystem::GetNumAxes(const EInputActionValueType ValueType)
+{
+	switch (ValueType)
+	{
+	case EInputActionValueType::Axis3D:
+		return 3;
+	case EInputActionValueType::Axis2D:
+		return 2;
+	default:
+		return 1;
+	}
+}
@@ -0,0 +1,103 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "InputActionValue.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PInputReplaySubsystem.generated.h"
+
+class UInputAction;
+
+/* Values of the recorded actions that changed on one frame, by index in the recorded actions. */
+struct FRecordedInputFrame
+{
+	uint32 FrameIndex = 0;
+
+	/* Seconds since the recording started. */
+	float Time = 0.0f;
+
+	TArray<TPair<uint8, FInputActionValue>, TInlineAllocator<4>> Changes;
+};
+
+/* Cost and portal activity of one replayed frame. */
+struct FInputReplayFrameStats
+{
+	float FrameTimeMs = 0.0f;
+	uint32 Captures = 0;
+	uint32 Teleports = 0;
+	int32 TrackedActors = 0;
+};
+
+/*
+ Records the Enhanced Input actions bound by the player character and its portal gun at a fixed timestep paced to real time,
+ and replays them at the same timestep as fast as possible so the same session can be benchmarked on every build:
+ Portal PlaygroundMap -game -PortalRecord=Session
+ Portal PlaygroundMap -game -nullrhi -unattended -PortalReplay=Session
+ Recordings go to Saved/InputRecordings, only the action values that change are written. A replay writes one line of timings
+ and portal event counts per frame to Saved/Benchmarks, and quits at the end when unattended.
+ */
+UCLASS()
+class PORTAL_API UPInputReplaySubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	bool IsRecording() const { return Mode == EInputReplayMode::Recording; }
+	bool IsReplaying() const { return Mode == EInputReplayMode::Replaying; }
+
+protected:
+	virtual bool DoesSupportWorldType(const EWorldType::Type WorldType) const override;
+
+private:
+	enum class EInputReplayMode : uint8
+	{
+		None,
+		Recording,
+		Replaying
+	};
+
+	/* Find the actions bound on the pawn and player controller input components, false until the player has a pawn. */
+	bool GatherBoundActions();
+
+	void RecordFrame();
+	void ReplayFrame();
+	void FinishReplay();
+
+	bool SaveRecording(const FString& Path) const;
+	bool LoadRecording(const FString& Path);
+	bool SaveReplayStats(const FString& Path) const;
+
+	/* A bare name is a file of the recordings folder. */
+	static FString GetRecordingPath(const FString& Name);
+
+	static int32 GetNumAxes(EInputActionValueType ValueType);
+
+	EInputReplayMode Mode = EInputReplayMode::None;
+	FString RecordingPath;
+	FString MapName;
+
+	/* Recorded actions, in the order of the recording file once replaying. An action the player doesn't bind anymore is null. */
+	TArray<const UInputAction*> Actions;
+	TArray<FString> ActionPaths;
+	TArray<FInputActionValue> CurrentValues;
+
+	bool bActionsBound = false;
+
+	TArray<FRecordedInputFrame> Frames;
+	uint32 FrameIndex = 0;
+	uint32 NumFrames = 0;
+	double StartTime = 0.0;
+	float FixedDeltaTime = 1.0f / 60.0f;
+
+	int32 ReplayCursor = 0;
+	TArray<FInputReplayFrameStats> FrameStats;
+	double LastFrameTime = 0.0;
+	uint32 LastNumCaptures = 0;
+	uint32 LastNumTeleports = 0;
+};
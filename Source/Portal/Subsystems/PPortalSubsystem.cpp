@@ -0,0 +1,455 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalSubsystem.h"
+
+#include "EngineUtils.h"
+#include "PBDRigidsSolver.h"
+#include "Camera/CameraComponent.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Components/StaticMeshComponent.h"
+#include "Physics/Experimental/PhysScene_Chaos.h"
+#include "PhysicsEngine/PhysicsSettings.h"
+#include "Portal/Portal.h"
+#include "Portal/PCharacter.h"
+#include "Portal/PGunComponent.h"
+#include "Portal/Helpers/PPortalHelper.h"
+#include "Portal/Helpers/PPortalPhysicsCallback.h"
+#include "Portal/Level/PPortal.h"
+
+static TAutoConsoleVariable<int32> CVarPortalCopyPoolSize(TEXT("sm.PortalCopyPoolSize"), 4, TEXT("Number of portal copies created up front for each class of physics actor in the level"), ECVF_Default);
+static TAutoConsoleVariable<bool> CVarPortalAsyncPhysics(TEXT("sm.PortalAsyncPhysics"), false, TEXT("Teleport simulated bodies through portals from a physics thread callback, applied on the next level load"), ECVF_Default);
+static TAutoConsoleVariable<float> CVarPortalRelevanceDistance(TEXT("sm.PortalRelevanceDistance"), 10000.0f, TEXT("Only portals closer than this distance to the player camera are rendered (0 = all portals)"), ECVF_Scalability);
+
+bool UPPortalSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UPPortalSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+	Super::OnWorldBeginPlay(InWorld);
+
+	CreateSceneCapture(InWorld);
+	PrewarmCopyPool(InWorld);
+
+	// Register the capture tick so every portal is rendered in a single batch after the camera update
+	CaptureTick.bCanEverTick = true;
+	CaptureTick.Target = this;
+	CaptureTick.TickGroup = TG_PostUpdateWork;
+	CaptureTick.RegisterTickFunction(InWorld.PersistentLevel);
+
+	RegisterPhysicsCallback(InWorld);
+}
+
+void UPPortalSubsystem::Deinitialize()
+{
+	if (CaptureTick.IsTickFunctionRegistered())
+		CaptureTick.UnRegisterTickFunction();
+
+	UnregisterPhysicsCallback();
+
+	RenderTargetPool.Reset();
+	CopyPool.Reset();
+	Portals.Reset();
+	PortalCells.Reset();
+	PortalCellKeys.Reset();
+
+	Super::Deinitialize();
+}
+
+void UPPortalSubsystem::CreateSceneCapture(UWorld& InWorld)
+{
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.Name = FName("PortalCaptureHost");
+	SpawnParams.ObjectFlags |= RF_Transient;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	CaptureHost = InWorld.SpawnActor<AActor>(AActor::StaticClass(), FTransform::Identity, SpawnParams);
+	check(CaptureHost);
+
+	SceneCapture = NewObject<USceneCaptureComponent2D>(CaptureHost, FName("PortalSceneCapture"));
+	SceneCapture->bEnableClipPlane = false;
+	SceneCapture->bUseCustomProjectionMatrix = false;
+	SceneCapture->bCaptureEveryFrame = false;
+	SceneCapture->bCaptureOnMovement = false;
+	SceneCapture->bAlwaysPersistRenderingState = false;
+	SceneCapture->LODDistanceFactor = 3;
+	SceneCapture->TextureTarget = nullptr;
+	SceneCapture->CaptureSource = SCS_SceneColorHDR;
+
+	CaptureHost->SetRootComponent(SceneCapture);
+	SceneCapture->RegisterComponent();
+}
+
+void UPPortalSubsystem::PrewarmCopyPool(UWorld& InWorld)
+{
+	const int32 CopiesPerClass = CVarPortalCopyPoolSize.GetValueOnGameThread();
+	if (CopiesPerClass <= 0)
+		return;
+
+	// Portals drawing instanced proxies never take copies from the pool, only fill it if a portal in the level or spawned by a gun uses pooled copies
+	bool bUsesPooledCopies = false;
+	for (TActorIterator<AActor> It(&InWorld); It && bUsesPooledCopies == false; ++It)
+	{
+		if (const APPortal* Portal = Cast<APPortal>(*It))
+		{
+			bUsesPooledCopies = Portal->UsesInstancedCopies() == false;
+			continue;
+		}
+
+		TInlineComponentArray<const UPGunComponent*> Guns(*It);
+		for (const UPGunComponent* Gun : Guns)
+		{
+			if (Gun->GetPortalClass() != nullptr && Gun->GetPortalClass()->GetDefaultObject<APPortal>()->UsesInstancedCopies() == false)
+				bUsesPooledCopies = true;
+		}
+	}
+
+	if (bUsesPooledCopies == false)
+		return;
+
+	// Portals track physics actors, the first instance of each class is the template of its copies
+	TSet<UClass*> PrewarmedClasses;
+	for (TActorIterator<AActor> It(&InWorld); It; ++It)
+	{
+		AActor* Actor = *It;
+		const USceneComponent* RootComponent = Actor->GetRootComponent();
+		if (RootComponent == nullptr || RootComponent->IsSimulatingPhysics() == false || Actor->IsA<APCharacter>())
+			continue;
+
+		if (PrewarmedClasses.Contains(Actor->GetClass()))
+			continue;
+
+		PrewarmedClasses.Add(Actor->GetClass());
+		CopyPool.Prewarm(Actor, CopiesPerClass);
+	}
+
+	UE_LOG(LogPortal, Log, TEXT("Portal copy pool prewarmed with %d copies"), CopyPool.NumFree());
+}
+
+void UPPortalSubsystem::RegisterPhysicsCallback(UWorld& InWorld)
+{
+	if (CVarPortalAsyncPhysics.GetValueOnGameThread() == false)
+		return;
+
+	FPhysScene* PhysicsScene = InWorld.GetPhysicsScene();
+	Chaos::FPhysicsSolver* Solver = PhysicsScene ? PhysicsScene->GetSolver() : nullptr;
+	if (Solver == nullptr)
+		return;
+
+	// Still works on the synchronous physics step, but the game thread then waits for the callback
+	if (UPhysicsSettings::Get()->bTickPhysicsAsync == false)
+		UE_LOG(LogPortal, Warning, TEXT("sm.PortalAsyncPhysics is on but physics doesn't tick asynchronously, enable Tick Physics Async in the physics settings"));
+
+	PhysicsCallback = Solver->CreateAndRegisterSimCallbackObject_External<FPortalPhysicsCallback>();
+	bPhysicsInputDirty = true;
+
+	// Teleports are read and bodies sent before physics runs
+	PhysicsSyncTick.bCanEverTick = true;
+	PhysicsSyncTick.Target = this;
+	PhysicsSyncTick.TickGroup = TG_PrePhysics;
+	PhysicsSyncTick.RegisterTickFunction(InWorld.PersistentLevel);
+}
+
+void UPPortalSubsystem::UnregisterPhysicsCallback()
+{
+	if (PhysicsSyncTick.IsTickFunctionRegistered())
+		PhysicsSyncTick.UnRegisterTickFunction();
+
+	if (PhysicsCallback == nullptr)
+		return;
+
+	FPhysScene* PhysicsScene = GetWorld()->GetPhysicsScene();
+	if (Chaos::FPhysicsSolver* Solver = PhysicsScene ? PhysicsScene->GetSolver() : nullptr)
+		Solver->UnregisterAndFreeSimCallbackObject_External(PhysicsCallback);
+
+	PhysicsCallback = nullptr;
+}
+
+void UPPortalSubsystem::SyncPhysicsCallback()
+{
+	if (PhysicsCallback == nullptr)
+		return;
+
+	// Move the tracking of bodies teleported by the finished physics steps to their target portal
+	while (Chaos::TSimCallbackOutputHandle<FPortalPhysicsOutput> Output = PhysicsCallback->PopFutureOutputData_External())
+	{
+		for (const FPortalPhysicsTeleport& Teleport : Output->Teleports)
+		{
+			APPortal* Portal = Teleport.Portal.Get();
+			AActor* Actor = Teleport.Actor.Get();
+			if (IsValid(Portal) && IsValid(Actor))
+				Portal->OnPhysicsThreadTeleport(Actor);
+		}
+	}
+
+	// Nothing is sent while the tracked bodies and portals stay the same, the callback keeps the last input
+	if (bPhysicsInputDirty == false)
+		return;
+
+	bPhysicsInputDirty = false;
+
+	FPortalPhysicsInput* Input = PhysicsCallback->GetProducerInputData_External();
+	Input->Reset();
+	Input->Gravity = FVector(0.0f, 0.0f, GetWorld()->GetGravityZ());
+
+	for (APPortal* Portal : Portals)
+	{
+		if (IsValid(Portal) == false || Portal->GetLinkedPortal() == nullptr)
+			continue;
+
+		const UStaticMeshComponent* PortalMesh = Portal->GetPortalMesh();
+		const int32 PortalIndex = Input->Portals.Num();
+
+		FPortalPhysicsPortal& PhysicsPortal = Input->Portals.AddDefaulted_GetRef();
+		PhysicsPortal.Portal = Portal;
+		PhysicsPortal.Plane = FPlane(PortalMesh->GetComponentLocation(), PortalMesh->GetForwardVector());
+		PhysicsPortal.PortalTransform = PortalMesh->GetComponentTransform();
+		PhysicsPortal.PortalSpaceTransform = Portal->GetPortalSpaceTransform();
+		PhysicsPortal.Extents = Portal->Extents;
+
+		for (const FTrackedActor& Tracked : Portal->GetTrackedActors())
+		{
+			if (Portal->IsTeleportedOnPhysicsThread(Tracked.Actor) == false)
+				continue;
+
+			UPrimitiveComponent* Comp = Cast<UPrimitiveComponent>(Tracked.Actor->GetRootComponent());
+			FPortalPhysicsBody& Body = Input->Bodies.AddDefaulted_GetRef();
+			Body.Actor = Tracked.Actor;
+			Body.Proxy = Comp->GetBodyInstance()->GetPhysicsActorHandle();
+			Body.Portal = PortalIndex;
+		}
+	}
+}
+
+void UPPortalSubsystem::RegisterPortal(APPortal* Portal)
+{
+	if (IsValid(Portal) == false)
+		return;
+
+	if (Portals.Contains(Portal) == false)
+		Portals.Add(Portal);
+
+	UpdatePortalCell(Portal);
+	MarkPhysicsInputDirty();
+}
+
+void UPPortalSubsystem::UnregisterPortal(APPortal* Portal)
+{
+	UnlinkPortal(Portal);
+	RemovePortalFromCell(Portal);
+
+	Portals.Remove(Portal);
+	RenderTargetPool.ReleaseOwner(Portal);
+	MarkPhysicsInputDirty();
+}
+
+void UPPortalSubsystem::LinkPortals(APPortal* PortalA, APPortal* PortalB)
+{
+	if (IsValid(PortalA) == false || IsValid(PortalB) == false || PortalA == PortalB)
+		return;
+
+	// A portal has a single link, the previous partners are left without one
+	for (APPortal* Portal : { PortalA, PortalB })
+	{
+		APPortal* PreviousPortal = Portal->GetLinkedPortal();
+		if (IsValid(PreviousPortal) && PreviousPortal != PortalA && PreviousPortal != PortalB && PreviousPortal->GetLinkedPortal() == Portal)
+			PreviousPortal->UnlinkPortal();
+	}
+
+	PortalA->LinkPortal(PortalB);
+	PortalB->LinkPortal(PortalA);
+}
+
+void UPPortalSubsystem::UnlinkPortal(APPortal* Portal)
+{
+	if (Portal == nullptr)
+		return;
+
+	APPortal* LinkedPortal = Portal->GetLinkedPortal();
+	Portal->UnlinkPortal();
+
+	if (IsValid(LinkedPortal) && LinkedPortal->GetLinkedPortal() == Portal)
+		LinkedPortal->UnlinkPortal();
+}
+
+FIntVector UPPortalSubsystem::GetPortalCell(const FVector& Location)
+{
+	return FIntVector(FMath::FloorToInt32(Location.X / PortalCellSize), FMath::FloorToInt32(Location.Y / PortalCellSize), FMath::FloorToInt32(Location.Z / PortalCellSize));
+}
+
+void UPPortalSubsystem::UpdatePortalCell(APPortal* Portal)
+{
+	if (Portals.Contains(Portal) == false)
+		return;
+
+	const FIntVector Cell = GetPortalCell(Portal->GetActorLocation());
+	if (const FIntVector* CurrentCell = PortalCellKeys.Find(Portal))
+	{
+		if (*CurrentCell == Cell)
+			return;
+
+		RemovePortalFromCell(Portal);
+	}
+
+	PortalCells.FindOrAdd(Cell).Add(Portal);
+	PortalCellKeys.Add(Portal, Cell);
+}
+
+void UPPortalSubsystem::RemovePortalFromCell(APPortal* Portal)
+{
+	FIntVector Cell;
+	if (PortalCellKeys.RemoveAndCopyValue(Portal, Cell) == false)
+		return;
+
+	TArray<APPortal*>& CellPortals = PortalCells.FindChecked(Cell);
+	CellPortals.RemoveSingleSwap(Portal, EAllowShrinking::No);
+	if (CellPortals.Num() == 0)
+		PortalCells.Remove(Cell);
+}
+
+void UPPortalSubsystem::FindPortalsInRadius(const FVector& Location, const double Radius, TArray<APPortal*, TInlineAllocator<16>>& OutPortals) const
+{
+	OutPortals.Reset();
+
+	if (Radius <= 0.0)
+	{
+		for (APPortal* Portal : Portals)
+			OutPortals.Add(Portal);
+
+		return;
+	}
+
+	const FIntVector MinCell = GetPortalCell(Location - FVector(Radius));
+	const FIntVector MaxCell = GetPortalCell(Location + FVector(Radius));
+	const FIntVector CellCount = MaxCell - MinCell + FIntVector(1);
+	const double RadiusSquared = Radius * Radius;
+
+	auto AddCellPortals = [&](const TArray<APPortal*>& CellPortals)
+	{
+		for (APPortal* Portal : CellPortals)
+		{
+			if (FVector::DistSquared(Portal->GetActorLocation(), Location) <= RadiusSquared)
+				OutPortals.Add(Portal);
+		}
+	};
+
+	// Walk whichever is smaller, the cells covered by the radius or the occupied cells
+	if (static_cast<int64>(CellCount.X) * CellCount.Y * CellCount.Z > PortalCells.Num())
+	{
+		for (const TPair<FIntVector, TArray<APPortal*>>& CellPortals : PortalCells)
+		{
+			const FIntVector& Cell = CellPortals.Key;
+			if (Cell.X >= MinCell.X && Cell.X <= MaxCell.X && Cell.Y >= MinCell.Y && Cell.Y <= MaxCell.Y && Cell.Z >= MinCell.Z && Cell.Z <= MaxCell.Z)
+				AddCellPortals(CellPortals.Value);
+		}
+
+		return;
+	}
+
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				if (const TArray<APPortal*>* CellPortals = PortalCells.Find(FIntVector(X, Y, Z)))
+					AddCellPortals(*CellPortals);
+			}
+		}
+	}
+}
+
+bool UPPortalSubsystem::TraceThroughPortals(const FVector& Start, const FVector& End, const FCollisionShape& Shape, FCollisionObjectQueryParams ObjectParams, FCollisionQueryParams QueryParams, const int32 MaxPortalHops, FPortalTraceResult& OutResult) const
+{
+	OutResult = FPortalTraceResult();
+	ObjectParams.AddObjectTypesToQuery(ECC_Portal);
+
+	FVector SegmentStart = Start;
+	FVector SegmentEnd = End;
+	APPortal* ExitPortal = nullptr;
+
+	for (int32 Hop = 0; ; Hop++)
+	{
+		FPortalTraceSegment& Segment = OutResult.Segments.AddDefaulted_GetRef();
+		Segment.Start = SegmentStart;
+		Segment.ExitPortal = ExitPortal;
+
+		FHitResult Hit;
+		const bool bHit = GetWorld()->SweepSingleByObjectType(Hit, SegmentStart, SegmentEnd, FQuat::Identity, ObjectParams, Shape, QueryParams);
+		Segment.End = bHit ? Hit.Location : SegmentEnd;
+		if (bHit == false)
+			return false;
+
+		// Anything but a linked portal ends the trace, so does any portal past the last hop
+		APPortal* HitPortal = Cast<APPortal>(Hit.GetActor());
+		APPortal* LinkedPortal = HitPortal ? HitPortal->GetLinkedPortal() : nullptr;
+		if (LinkedPortal == nullptr || Hop >= MaxPortalHops)
+		{
+			OutResult.Hit = Hit;
+			OutResult.bBlockingHit = true;
+			return true;
+		}
+
+		// Go on with the rest of the segment on the other side, the exit portal is right at its start
+		const FTransform& PortalSpaceTransform = HitPortal->GetPortalSpaceTransform();
+		SegmentStart = PortalSpaceTransform.TransformPosition(Hit.Location);
+		SegmentEnd = PortalSpaceTransform.TransformPosition(SegmentEnd);
+		OutResult.SpaceTransform = OutResult.SpaceTransform * PortalSpaceTransform;
+		OutResult.Portals.Add(HitPortal);
+		ExitPortal = LinkedPortal;
+
+		QueryParams.AddIgnoredActor(LinkedPortal);
+	}
+}
+
+void UPPortalSubsystem::CapturePortals(float DeltaTime)
+{
+	PORTAL_SCOPE_CYCLE_COUNTER(STAT_PortalCapturePortals);
+
+	CaptureTimeSpentMs = 0.0;
+
+	// Teleports are counted over one second windows
+	const double Now = GetWorld()->GetRealTimeSeconds();
+	if (Now - TeleportWindowStart >= 1.0)
+	{
+		SET_FLOAT_STAT(STAT_PortalTeleportsPerSecond, TeleportsInWindow / (Now - TeleportWindowStart));
+		TeleportsInWindow = 0;
+		TeleportWindowStart = Now;
+	}
+
+	if (SceneCapture == nullptr || Portals.Num() == 0)
+		return;
+
+	// Post-process settings are the same for every capture, copy them once per frame
+	const APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	const APCharacter* Character = PlayerController ? Cast<APCharacter>(PlayerController->GetPawn()) : nullptr;
+	if (Character != nullptr)
+		SceneCapture->PostProcessSettings = Character->GetFirstPersonCameraComponent()->PostProcessSettings;
+
+	// Only the portals around the player are rendered, far ones keep their last view
+	TArray<APPortal*, TInlineAllocator<16>> RelevantPortals;
+	const FVector ViewLocation = PlayerController && PlayerController->PlayerCameraManager ? PlayerController->PlayerCameraManager->GetCameraCacheView().Location : FVector::ZeroVector;
+	const double RelevanceDistance = PlayerController && PlayerController->PlayerCameraManager ? CVarPortalRelevanceDistance.GetValueOnGameThread() : 0.0;
+	FindPortalsInRadius(ViewLocation, RelevanceDistance, RelevantPortals);
+
+	for (APPortal* Portal : RelevantPortals)
+	{
+		if (IsValid(Portal))
+			Portal->TickPortalView();
+	}
+}
+
+void FPortalCaptureTick::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	// Run the capture batch of the subsystem
+	if (Target)
+		Target->CapturePortals(DeltaTime);
+}
+
+void FPortalPhysicsSyncTick::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target)
+		Target->SyncPhysicsCallback();
+}
@@ -0,0 +1,203 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Portal/Helpers/PPortalCopyPool.h"
+#include "Portal/Helpers/PPortalRenderTargetPool.h"
+#include "PPortalSubsystem.generated.h"
+
+class APPortal;
+class FPortalPhysicsCallback;
+class USceneCaptureComponent2D;
+
+/* Capture tick of the portal subsystem, runs after the camera update like the portals used to. */
+USTRUCT()
+struct FPortalCaptureTick : public FTickFunction
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class UPPortalSubsystem* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override { return TEXT("FPortalCaptureTick"); }
+};
+
+template <>
+struct TStructOpsTypeTraits<FPortalCaptureTick> : public TStructOpsTypeTraitsBase2<FPortalCaptureTick>
+{
+	enum { WithCopy = false };
+};
+
+/* Pre-physics tick of the portal subsystem, exchanges the tracked bodies and teleports with the physics thread callback. */
+USTRUCT()
+struct FPortalPhysicsSyncTick : public FTickFunction
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	class UPPortalSubsystem* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+	virtual FString DiagnosticMessage() override { return TEXT("FPortalPhysicsSyncTick"); }
+};
+
+template <>
+struct TStructOpsTypeTraits<FPortalPhysicsSyncTick> : public TStructOpsTypeTraitsBase2<FPortalPhysicsSyncTick>
+{
+	enum { WithCopy = false };
+};
+
+/* One straight part of a trace through portals, every part after the first starts on the exit side of a portal. */
+struct FPortalTraceSegment
+{
+	FVector Start = FVector::ZeroVector;
+	FVector End = FVector::ZeroVector;
+
+	/* Portal the segment comes out of, nullptr for the first segment. */
+	APPortal* ExitPortal = nullptr;
+};
+
+/* Result of a trace through portals. */
+struct FPortalTraceResult
+{
+	TArray<FPortalTraceSegment, TInlineAllocator<4>> Segments;
+
+	/* Portals gone through, in order. */
+	TArray<APPortal*, TInlineAllocator<4>> Portals;
+
+	/* Final blocking hit, in the space of the last segment. */
+	FHitResult Hit;
+	bool bBlockingHit = false;
+
+	/* From the space of the trace start to the space of the last segment, identity if no portal was gone through. */
+	FTransform SpaceTransform = FTransform::Identity;
+};
+
+/*
+ World subsystem owning the rendering side of every portal.
+ All portal views are captured in one batch per frame with a single shared scene capture component, post-process settings
+ copied once from the player camera and one render target pool shared by all portals.
+ */
+UCLASS()
+class PORTAL_API UPPortalSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+	/* Make the capture tick friend so it can run the batch. */
+	friend FPortalCaptureTick;
+	friend FPortalPhysicsSyncTick;
+
+public:
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Deinitialize() override;
+
+	void RegisterPortal(APPortal* Portal);
+	void UnregisterPortal(APPortal* Portal);
+
+	const TArray<TObjectPtr<APPortal>>& GetPortals() const { return Portals; }
+
+	/* Link two portals to each other, any portal previously linked to either of them is left unlinked. */
+	void LinkPortals(APPortal* PortalA, APPortal* PortalB);
+
+	/* Unlink a portal and the portal it was linked to. */
+	void UnlinkPortal(APPortal* Portal);
+
+	/* Registered portals within Radius of a location, every portal if Radius is 0. Cost scales with the nearby portals only. */
+	void FindPortalsInRadius(const FVector& Location, double Radius, TArray<APPortal*, TInlineAllocator<16>>& OutPortals) const;
+
+	/* Move a portal to the grid cell of its current location. */
+	void UpdatePortalCell(APPortal* Portal);
+
+	/*
+	 Sweep a shape from Start to End, going on through up to MaxPortalHops linked portals, a line is traced if Shape is a line.
+	 Portals are always added to the queried object types. Returns whether the trace ended on a blocking hit.
+	 */
+	bool TraceThroughPortals(const FVector& Start, const FVector& End, const FCollisionShape& Shape, FCollisionObjectQueryParams ObjectParams, FCollisionQueryParams QueryParams, int32 MaxPortalHops, FPortalTraceResult& OutResult) const;
+
+	/* Scene capture shared by every portal, set it up completely before each CaptureScene call. */
+	USceneCaptureComponent2D* GetSceneCapture() const { return SceneCapture; }
+
+	FPortalRenderTargetPool& GetRenderTargetPool() { return RenderTargetPool; }
+
+	FPortalCopyPool& GetCopyPool() { return CopyPool; }
+
+	/* Game thread time already spent in portal captures this frame, for the recursion budget. */
+	double GetCaptureTimeSpentMs() const { return CaptureTimeSpentMs; }
+	void AddCaptureTime(const double TimeMs) { CaptureTimeSpentMs += TimeMs; NumCaptures++; }
+
+	/* Count a teleport for the teleports per second stat. */
+	void AddTeleport() { TeleportsInWindow++; NumTeleports++; }
+
+	/* Portal view captures and teleports since the world began play. */
+	uint32 GetNumCaptures() const { return NumCaptures; }
+	uint32 GetNumTeleports() const { return NumTeleports; }
+
+	/* Whether simulated bodies are teleported by the physics thread callback instead of the portals post-physics tick. */
+	bool IsPhysicsCallbackEnabled() const { return PhysicsCallback != nullptr; }
+
+	/* Send the portals and their tracked bodies to the physics thread before the next step. */
+	void MarkPhysicsInputDirty() { bPhysicsInputDirty = true; }
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+private:
+	/* Capture every registered portal that needs it, called once per frame after the camera update. */
+	void CapturePortals(float DeltaTime);
+
+	void CreateSceneCapture(UWorld& InWorld);
+
+	/* Size of a portal grid cell in centimeters. */
+	static constexpr double PortalCellSize = 2000.0;
+
+	static FIntVector GetPortalCell(const FVector& Location);
+	void RemovePortalFromCell(APPortal* Portal);
+
+	/* Fill the copy pool for every class of physics actor placed in the level, so no copy is created during gameplay. */
+	void PrewarmCopyPool(UWorld& InWorld);
+
+	void RegisterPhysicsCallback(UWorld& InWorld);
+	void UnregisterPhysicsCallback();
+
+	/* Hand the physics thread teleports over to the portals, then send the tracked bodies if they changed. */
+	void SyncPhysicsCallback();
+
+	UPROPERTY()
+	TArray<TObjectPtr<APPortal>> Portals;
+
+	/* Portals by grid cell of their location, the portals are kept alive by the portal list. */
+	TMap<FIntVector, TArray<APPortal*>> PortalCells;
+	TMap<const APPortal*, FIntVector> PortalCellKeys;
+
+	UPROPERTY()
+	TObjectPtr<AActor> CaptureHost;
+
+	UPROPERTY()
+	TObjectPtr<USceneCaptureComponent2D> SceneCapture;
+
+	UPROPERTY()
+	FPortalRenderTargetPool RenderTargetPool;
+
+	UPROPERTY()
+	FPortalCopyPool CopyPool;
+
+	FPortalCaptureTick CaptureTick;
+
+	double CaptureTimeSpentMs = 0.0;
+
+	int32 TeleportsInWindow = 0;
+	double TeleportWindowStart = 0.0;
+
+	uint32 NumCaptures = 0;
+	uint32 NumTeleports = 0;
+
+	/* Owned by the physics solver, only created when sm.PortalAsyncPhysics is on. */
+	FPortalPhysicsCallback* PhysicsCallback = nullptr;
+
+	FPortalPhysicsSyncTick PhysicsSyncTick;
+
+	bool bPhysicsInputDirty = false;
+};
@@ -0,0 +1,245 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PPortalWallSubsystem.h"
+
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Portal/Level/PPortalWall.h"
+
+bool UPPortalWallSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UPPortalWallSubsystem::Deinitialize()
+{
+	Walls.Reset();
+	WallIndices.Reset();
+	Cells.Reset();
+
+	Super::Deinitialize();
+}
+
+void UPPortalWallSubsystem::RegisterWall(APPortalWall* Wall)
+{
+	if (IsValid(Wall) == false || WallIndices.Contains(Wall))
+		return;
+
+	FPortalWallEntry Entry;
+	Entry.Wall = Wall;
+	if (UpdateEntry(Entry) == false)
+		return;
+
+	const int32 Index = Walls.Add(Entry);
+	WallIndices.Add(Wall, Index);
+	InsertIntoCells(Index);
+}
+
+void UPPortalWallSubsystem::UnregisterWall(const APPortalWall* Wall)
+{
+	int32 Index;
+	if (WallIndices.RemoveAndCopyValue(Wall, Index) == false)
+		return;
+
+	RemoveFromCells(Index);
+
+	// Move the last wall in the freed index
+	const int32 LastIndex = Walls.Num() - 1;
+	if (Index != LastIndex)
+	{
+		RemoveFromCells(LastIndex);
+		Walls[Index] = Walls[LastIndex];
+		WallIndices[Walls[Index].Wall] = Index;
+		InsertIntoCells(Index);
+	}
+
+	Walls.Pop(EAllowShrinking::No);
+}
+
+void UPPortalWallSubsystem::UpdateWall(const APPortalWall* Wall)
+{
+	const int32* Index = WallIndices.Find(Wall);
+	if (Index == nullptr)
+		return;
+
+	RemoveFromCells(*Index);
+	if (UpdateEntry(Walls[*Index]))
+		InsertIntoCells(*Index);
+}
+
+bool UPPortalWallSubsystem::RaycastWalls(const FVector& Start, const FVector& Direction, const double MaxDistance, FPortalWallHit& OutHit)
+{
+	if (Walls.Num() == 0)
+		return false;
+
+	QueryCounter++;
+
+	// Walk the cells along the ray (3D DDA), stepping on the axis whose next cell boundary is the closest
+	FIntVector Cell = GetCell(Start);
+	FIntVector Step;
+	FVector NextBoundaryDistance;
+	FVector CellCrossDistance;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if (FMath::Abs(Direction[Axis]) < UE_SMALL_NUMBER)
+		{
+			Step[Axis] = 0;
+			NextBoundaryDistance[Axis] = UE_BIG_NUMBER;
+			CellCrossDistance[Axis] = UE_BIG_NUMBER;
+			continue;
+		}
+
+		Step[Axis] = Direction[Axis] > 0.0 ? 1 : -1;
+		const double Boundary = (Cell[Axis] + (Step[Axis] > 0 ? 1 : 0)) * CellSize;
+		NextBoundaryDistance[Axis] = (Boundary - Start[Axis]) / Direction[Axis];
+		CellCrossDistance[Axis] = CellSize / FMath::Abs(Direction[Axis]);
+	}
+
+	bool bHit = false;
+	double BestDistance = MaxDistance;
+	double CellEnterDistance = 0.0;
+
+	// A hit in a later cell can be found early, keep walking until no closer hit is possible
+	while (CellEnterDistance <= BestDistance)
+	{
+		if (const TArray<int32>* CellWalls = Cells.Find(Cell))
+		{
+			for (const int32 Index : *CellWalls)
+			{
+				FPortalWallEntry& Entry = Walls[Index];
+				if (Entry.QueryStamp == QueryCounter)
+					continue;
+
+				Entry.QueryStamp = QueryCounter;
+
+				double Distance;
+				FVector Normal;
+				if (IntersectWall(Entry, Start, Direction, Distance, Normal) == false || Distance > BestDistance)
+					continue;
+
+				bHit = true;
+				BestDistance = Distance;
+				OutHit.Wall = Entry.Wall;
+				OutHit.Location = Start + Direction * Distance;
+				OutHit.Normal = Normal;
+				OutHit.Distance = Distance;
+			}
+		}
+
+		const int32 Axis = NextBoundaryDistance.X < NextBoundaryDistance.Y ? (NextBoundaryDistance.X < NextBoundaryDistance.Z ? 0 : 2) : (NextBoundaryDistance.Y < NextBoundaryDistance.Z ? 1 : 2);
+		CellEnterDistance = NextBoundaryDistance[Axis];
+		NextBoundaryDistance[Axis] += CellCrossDistance[Axis];
+		Cell[Axis] += Step[Axis];
+	}
+
+	return bHit;
+}
+
+FIntVector UPPortalWallSubsystem::GetCell(const FVector& Location)
+{
+	return FIntVector(FMath::FloorToInt32(Location.X / CellSize), FMath::FloorToInt32(Location.Y / CellSize), FMath::FloorToInt32(Location.Z / CellSize));
+}
+
+bool UPPortalWallSubsystem::UpdateEntry(FPortalWallEntry& Entry)
+{
+	const UStaticMeshComponent* Mesh = Entry.Wall->GetMesh();
+	if (Mesh == nullptr || Mesh->GetStaticMesh() == nullptr)
+		return false;
+
+	// Scale is applied to the box so the transform stays rigid
+	const FTransform& MeshTransform = Mesh->GetComponentTransform();
+	const FVector Scale = MeshTransform.GetScale3D();
+	const FBox MeshBox = Mesh->GetStaticMesh()->GetBoundingBox();
+
+	Entry.Transform = FTransform(MeshTransform.GetRotation(), MeshTransform.GetLocation());
+	Entry.LocalBox = FBox(ForceInit);
+	Entry.LocalBox += MeshBox.Min * Scale;
+	Entry.LocalBox += MeshBox.Max * Scale;
+	Entry.WorldBounds = Mesh->Bounds.GetBox();
+
+	return true;
+}
+
+bool UPPortalWallSubsystem::IntersectWall(const FPortalWallEntry& Entry, const FVector& Start, const FVector& Direction, double& OutDistance, FVector& OutNormal)
+{
+	const FVector LocalStart = Entry.Transform.InverseTransformPositionNoScale(Start);
+	const FVector LocalDirection = Entry.Transform.InverseTransformVectorNoScale(Direction);
+
+	// Slab test, the face hit is the one of the axis entered last
+	double EnterDistance = -UE_BIG_NUMBER;
+	double ExitDistance = UE_BIG_NUMBER;
+	int32 EnterAxis = INDEX_NONE;
+	for (int32 Axis = 0; Axis < 3; Axis++)
+	{
+		if (FMath::Abs(LocalDirection[Axis]) < UE_SMALL_NUMBER)
+		{
+			if (LocalStart[Axis] < Entry.LocalBox.Min[Axis] || LocalStart[Axis] > Entry.LocalBox.Max[Axis])
+				return false;
+
+			continue;
+		}
+
+		double NearDistance = (Entry.LocalBox.Min[Axis] - LocalStart[Axis]) / LocalDirection[Axis];
+		double FarDistance = (Entry.LocalBox.Max[Axis] - LocalStart[Axis]) / LocalDirection[Axis];
+		if (NearDistance > FarDistance)
+			Swap(NearDistance, FarDistance);
+
+		if (NearDistance > EnterDistance)
+		{
+			EnterDistance = NearDistance;
+			EnterAxis = Axis;
+		}
+
+		ExitDistance = FMath::Min(ExitDistance, FarDistance);
+		if (EnterDistance > ExitDistance)
+			return false;
+	}
+
+	if (EnterAxis == INDEX_NONE || EnterDistance < 0.0)
+		return false;
+
+	FVector LocalNormal = FVector::ZeroVector;
+	LocalNormal[EnterAxis] = LocalDirection[EnterAxis] > 0.0 ? -1.0 : 1.0;
+
+	OutDistance = EnterDistance;
+	OutNormal = Entry.Transform.TransformVectorNoScale(LocalNormal);
+	return true;
+}
+
+void UPPortalWallSubsystem::InsertIntoCells(const int32 Index)
+{
+	const FIntVector MinCell = GetCell(Walls[Index].WorldBounds.Min);
+	const FIntVector MaxCell = GetCell(Walls[Index].WorldBounds.Max);
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+				Cells.FindOrAdd(FIntVector(X, Y, Z)).Add(Index);
+		}
+	}
+}
+
+void UPPortalWallSubsystem::RemoveFromCells(const int32 Index)
+{
+	const FIntVector MinCell = GetCell(Walls[Index].WorldBounds.Min);
+	const FIntVector MaxCell = GetCell(Walls[Index].WorldBounds.Max);
+	for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+	{
+		for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+		{
+			for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+			{
+				const FIntVector Cell(X, Y, Z);
+				TArray<int32>* CellWalls = Cells.Find(Cell);
+				if (CellWalls == nullptr)
+					continue;
+
+				CellWalls->RemoveSingleSwap(Index, EAllowShrinking::No);
+				if (CellWalls->Num() == 0)
+					Cells.Remove(Cell);
+			}
+		}
+	}
+}
@@ -0,0 +1,87 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PPortalWallSubsystem.generated.h"
+
+class APPortalWall;
+
+/* Closest portal wall surface hit by a ray. */
+struct FPortalWallHit
+{
+	APPortalWall* Wall = nullptr;
+	FVector Location = FVector::ZeroVector;
+	FVector Normal = FVector::ZeroVector;
+	double Distance = 0.0;
+};
+
+/* A registered wall, its mesh box is stored unscaled in the mesh space so rays are tested against the oriented box. */
+USTRUCT()
+struct FPortalWallEntry
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TObjectPtr<APPortalWall> Wall = nullptr;
+
+	FTransform Transform;
+	FBox LocalBox = FBox(ForceInit);
+	FBox WorldBounds = FBox(ForceInit);
+
+	/* Last query that tested this wall, a wall spanning several cells is only tested once per query. */
+	uint32 QueryStamp = 0;
+};
+
+/*
+ Registry of every portal wall in the world, in a uniform grid of cells.
+ The portal gun walks the cells along its ray and only tests the walls found there, instead of tracing the whole physics scene.
+ */
+UCLASS()
+class PORTAL_API UPPortalWallSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	void RegisterWall(APPortalWall* Wall);
+	void UnregisterWall(const APPortalWall* Wall);
+
+	/* Move a registered wall to the cells of its new bounds. */
+	void UpdateWall(const APPortalWall* Wall);
+
+	/* Find the closest portal wall hit by a ray, Direction must be normalized. Other geometry is ignored. */
+	bool RaycastWalls(const FVector& Start, const FVector& Direction, double MaxDistance, FPortalWallHit& OutHit);
+
+	int32 NumWalls() const { return Walls.Num(); }
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+private:
+	/* Size of a grid cell in centimeters. */
+	static constexpr double CellSize = 1000.0;
+
+	static FIntVector GetCell(const FVector& Location);
+
+	/* Fill an entry from the current transform and mesh of its wall. Returns false if the wall has no mesh. */
+	static bool UpdateEntry(FPortalWallEntry& Entry);
+
+	/* Ray test against the oriented box of a wall, the ray must start outside of it. */
+	static bool IntersectWall(const FPortalWallEntry& Entry, const FVector& Start, const FVector& Direction, double& OutDistance, FVector& OutNormal);
+
+	void InsertIntoCells(int32 Index);
+	void RemoveFromCells(int32 Index);
+
+	UPROPERTY()
+	TArray<FPortalWallEntry> Walls;
+
+	TMap<const APPortalWall*, int32> WallIndices;
+
+	/* Indices of the walls overlapping each non-empty cell. */
+	TMap<FIntVector, TArray<int32>> Cells;
+
+	uint32 QueryCounter = 0;
+};
@@ -0,0 +1,199 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "PSignalSubsystem.h"
+
+#include "TimerManager.h"
+#include "Engine/World.h"
+#include "Portal/Level/PPortal.h"
+
+bool UPSignalSubsystem::DoesSupportWorldType(const EWorldType::Type WorldType) const
+{
+	return WorldType == EWorldType::Game || WorldType == EWorldType::PIE;
+}
+
+void UPSignalSubsystem::Deinitialize()
+{
+	for (TPair<const UObject*, FPSignalNode>& Pair : Nodes)
+		GetWorld()->GetTimerManager().ClearTimer(Pair.Value.HoldTimer);
+
+	Nodes.Reset();
+
+	Super::Deinitialize();
+}
+
+void UPSignalSubsystem::AddNode(const UObject* Node, const EPSignalLogic Logic, const TConstArrayView<const UObject*> Inputs, FOnSignalChanged OnChanged, const float HoldTime)
+{
+	if (IsValid(Node) == false)
+		return;
+
+	FPSignalNode& NewNode = Nodes.FindOrAdd(Node);
+	for (const UObject* Input : NewNode.Inputs)
+	{
+		if (FPSignalNode* InputNode = Nodes.Find(Input))
+			InputNode->Outputs.Remove(Node);
+	}
+
+	NewNode.Logic = Logic;
+	NewNode.HoldTime = HoldTime;
+	NewNode.OnChanged = MoveTemp(OnChanged);
+	NewNode.Inputs.Reset();
+	for (const UObject* Input : Inputs)
+	{
+		if (Input == nullptr || Input == Node || NewNode.Inputs.Contains(Input))
+			continue;
+
+		NewNode.Inputs.Add(Input);
+	}
+
+	// Adding the inputs may grow the map, the node is looked up again after
+	for (const UObject* Input : Nodes[Node].Inputs)
+		Nodes.FindOrAdd(Input).Outputs.AddUnique(Node);
+
+	FPSignalNode& AddedNode = Nodes[Node];
+	if (EvaluateNode(Node, AddedNode))
+	{
+		const FOnSignalChanged Delegate = AddedNode.OnChanged;
+		const bool bIsActive = AddedNode.bIsActive;
+		Propagate(Node);
+		Delegate.ExecuteIfBound(bIsActive);
+	}
+}
+
+void UPSignalSubsystem::RemoveNode(const UObject* Node)
+{
+	FPSignalNode* RemovedNode = Nodes.Find(Node);
+	if (RemovedNode == nullptr)
+		return;
+
+	// Unbind first, the object is going away
+	RemovedNode->OnChanged.Unbind();
+	GetWorld()->GetTimerManager().ClearTimer(RemovedNode->HoldTimer);
+	SetNodeActive(Node, *RemovedNode, false);
+
+	RemovedNode = &Nodes[Node];
+	for (const UObject* Input : RemovedNode->Inputs)
+	{
+		if (FPSignalNode* InputNode = Nodes.Find(Input))
+			InputNode->Outputs.Remove(Node);
+	}
+
+	if (RemovedNode->Outputs.Num() > 0)
+	{
+		RemovedNode->Logic = EPSignalLogic::Source;
+		RemovedNode->Inputs.Reset();
+	}
+	else
+	{
+		Nodes.Remove(Node);
+	}
+}
+
+void UPSignalSubsystem::SetSourceActive(const UObject* Node, const bool bIsActive)
+{
+	FPSignalNode* SourceNode = Nodes.Find(Node);
+	if (SourceNode == nullptr || ensureMsgf(SourceNode->Logic == EPSignalLogic::Source, TEXT("'%s' is not a signal source."), *GetNameSafe(Node)) == false)
+		return;
+
+	SetNodeActive(Node, *SourceNode, bIsActive);
+}
+
+bool UPSignalSubsystem::IsActive(const UObject* Node) const
+{
+	const FPSignalNode* FoundNode = Nodes.Find(Node);
+	return FoundNode && FoundNode->bIsActive;
+}
+
+bool UPSignalSubsystem::EvaluateNode(const UObject* Key, FPSignalNode& Node)
+{
+	if (Node.Logic == EPSignalLogic::Source)
+		return false;
+
+	bool bIsActive;
+	if (Node.Logic == EPSignalLogic::And)
+	{
+		bIsActive = Node.Inputs.Num() > 0;
+		for (const UObject* Input : Node.Inputs)
+		{
+			if (IsActive(Input) == false)
+			{
+				bIsActive = false;
+				break;
+			}
+		}
+	}
+	else
+	{
+		bIsActive = false;
+		for (const UObject* Input : Node.Inputs)
+		{
+			if (IsActive(Input))
+			{
+				bIsActive = true;
+				break;
+			}
+		}
+	}
+
+	// A timer holds its state until its timer elapses
+	if (Node.Logic == EPSignalLogic::Timer)
+	{
+		FTimerManager& TimerManager = GetWorld()->GetTimerManager();
+		if (bIsActive)
+		{
+			TimerManager.ClearTimer(Node.HoldTimer);
+		}
+		else if (Node.bIsActive && Node.HoldTime > 0.0f)
+		{
+			if (TimerManager.IsTimerActive(Node.HoldTimer) == false)
+				TimerManager.SetTimer(Node.HoldTimer, FTimerDelegate::CreateUObject(this, &UPSignalSubsystem::OnHoldTimeElapsed, Key), Node.HoldTime, false);
+
+			return false;
+		}
+	}
+
+	if (bIsActive == Node.bIsActive)
+		return false;
+
+	Node.bIsActive = bIsActive;
+	return true;
+}
+
+void UPSignalSubsystem::Propagate(const UObject* ChangedNode)
+{
+	TArray<const UObject*, TInlineAllocator<16>> Dirty(Nodes[ChangedNode].Outputs);
+	for (int32 i = 0; i < Dirty.Num(); i++)
+	{
+		if (i == MaxPropagationSteps)
+		{
+			UE_LOG(LogPortal, Error, TEXT("Signal propagation from '%s' stopped after %d steps, the signal network has a feedback loop."), *GetNameSafe(ChangedNode), MaxPropagationSteps);
+			return;
+		}
+
+		FPSignalNode* Node = Nodes.Find(Dirty[i]);
+		if (Node == nullptr || EvaluateNode(Dirty[i], *Node) == false)
+			continue;
+
+		// The callback may change the network, nothing of the node is used after it
+		Dirty.Append(Node->Outputs);
+		const FOnSignalChanged Delegate = Node->OnChanged;
+		Delegate.ExecuteIfBound(Node->bIsActive);
+	}
+}
+
+void UPSignalSubsystem::SetNodeActive(const UObject* Key, FPSignalNode& Node, const bool bIsActive)
+{
+	if (Node.bIsActive == bIsActive)
+		return;
+
+	Node.bIsActive = bIsActive;
+	const FOnSignalChanged Delegate = Node.OnChanged;
+	Propagate(Key);
+	Delegate.ExecuteIfBound(bIsActive);
+}
+
+void UPSignalSubsystem::OnHoldTimeElapsed(const UObject* Key)
+{
+	if (FPSignalNode* Node = Nodes.Find(Key))
+		SetNodeActive(Key, *Node, false);
+}
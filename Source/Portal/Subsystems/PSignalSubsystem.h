@@ -0,0 +1,85 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PSignalSubsystem.generated.h"
+
+/* How a signal node computes its state from its inputs. */
+UENUM(BlueprintType)
+enum class EPSignalLogic : uint8
+{
+	/* Set from gameplay, a trigger for example. */
+	Source,
+
+	/* Active when every input is active. */
+	And,
+
+	/* Active when any input is active. */
+	Or,
+
+	/* Active when any input is active, then stays active for the hold time after the last one deactivates. */
+	Timer
+};
+
+DECLARE_DELEGATE_OneParam(FOnSignalChanged, bool /* bIsActive */);
+
+/* A node of the signal network, its inputs and outputs are other nodes. */
+struct FPSignalNode
+{
+	EPSignalLogic Logic = EPSignalLogic::Source;
+	float HoldTime = 0.0f;
+
+	TArray<const UObject*> Inputs;
+	TArray<const UObject*> Outputs;
+
+	/* Called when the node state changes, never for the initial inactive state. */
+	FOnSignalChanged OnChanged;
+
+	FTimerHandle HoldTimer;
+	bool bIsActive = false;
+};
+
+/*
+ Network of puzzle signals: triggers, doors, logic gates and any other device are nodes keyed by their object.
+ A node is only evaluated again when one of its inputs changes, idle puzzle elements don't tick.
+ Inputs may be registered after the nodes using them, they are inactive sources until then.
+ */
+UCLASS()
+class PORTAL_API UPSignalSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	/* Register a node, or change the logic and inputs of a registered one. OnChanged is called right away if the node starts active. */
+	void AddNode(const UObject* Node, EPSignalLogic Logic, TConstArrayView<const UObject*> Inputs, FOnSignalChanged OnChanged, float HoldTime = 0.0f);
+
+	/* Deactivate a node and unregister it, its outputs keep it as an inactive source. */
+	void RemoveNode(const UObject* Node);
+
+	/* Set the state of a source node and propagate it. */
+	void SetSourceActive(const UObject* Node, bool bIsActive);
+
+	bool IsActive(const UObject* Node) const;
+
+protected:
+	virtual bool DoesSupportWorldType(EWorldType::Type WorldType) const override;
+
+private:
+	/* A feedback loop of gates stops propagating after this many evaluations. */
+	static constexpr int32 MaxPropagationSteps = 4096;
+
+	/* Compute the state of a node from its inputs, returns true if it changed. */
+	bool EvaluateNode(const UObject* Key, FPSignalNode& Node);
+
+	/* Evaluate the outputs of a changed node, and the outputs of those that change in turn. */
+	void Propagate(const UObject* ChangedNode);
+
+	void SetNodeActive(const UObject* Key, FPSignalNode& Node, bool bIsActive);
+	void OnHoldTimeElapsed(const UObject* Key);
+
+	TMap<const UObject*, FPSignalNode> Nodes;
+};
@@ -0,0 +1,203 @@
+﻿// Copyright (c) 2025 Maurel Sagbo
+
+
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Portal/Helpers/PPortalHelper.h"
+#include "Portal/Level/PGhostPortalBorder.h"
+#include "Portal/Level/PPortal.h"
+#include "Portal/Level/PPortalWall.h"
+#include "Portal/Subsystems/PPortalSubsystem.h"
+
+/*
+ Automation tests of the portal math and placement, they don't need a renderer:
+ UnrealEditor-Cmd Portal.uproject -nullrhi -unattended -ExecCmds="Automation RunTests Portal; Quit"
+ */
+
+namespace PortalTests
+{
+	/* Half extents of every test portal, in centimeters. */
+	const FVector2D PortalExtents(60.0, 100.0);
+
+	/* A 20 by 10 meters wall facing X with two holes, and one portal pair on it, in a transient world that never begins play. */
+	struct FPortalTestWorld
+	{
+		FPortalTestWorld()
+		{
+			World = UWorld::CreateWorld(EWorldType::Game, false, FName("PortalAutomationTest"));
+			FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+			WorldContext.SetCurrentWorld(World);
+
+			Wall = World->SpawnActorDeferred<APPortalWall>(APPortalWall::StaticClass(), FTransform::Identity);
+			Wall->SetSize(2000.0f, 1000.0f);
+			Wall->SetHoles({ FBox2D(FVector2D(-600.0, -200.0), FVector2D(-400.0, 200.0)), FBox2D(FVector2D(400.0, -200.0), FVector2D(600.0, 200.0)) });
+			Wall->FinishSpawning(FTransform::Identity);
+
+			for (const bool bIsLeftPortal : { true, false })
+			{
+				const FTransform PortalTransform(FVector(1.0, bIsLeftPortal ? -250.0 : 250.0, 0.0));
+				APPortal* Portal = World->SpawnActorDeferred<APPortal>(APPortal::StaticClass(), PortalTransform, Wall);
+				Portal->Init(bIsLeftPortal);
+				Portal->FinishSpawning(PortalTransform);
+
+				Portal->PlaceOnWall(Wall, PortalExtents, false);
+				Portal->RegisterWithPortalSubsystem();
+
+				if (bIsLeftPortal)
+					LeftPortal = Portal;
+				else
+					RightPortal = Portal;
+			}
+
+			World->GetSubsystem<UPPortalSubsystem>()->LinkPortals(LeftPortal, RightPortal);
+		}
+
+		~FPortalTestWorld()
+		{
+			UPPortalSubsystem* PortalSubsystem = World->GetSubsystem<UPPortalSubsystem>();
+			PortalSubsystem->UnregisterPortal(LeftPortal);
+			PortalSubsystem->UnregisterPortal(RightPortal);
+
+			GEngine->DestroyWorldContext(World);
+			World->DestroyWorld(false);
+		}
+
+		/* World location of a wall space Y and Z location, on the plane the portals are placed on. */
+		FVector ToWorld(const FVector2D& WallLocation) const
+		{
+			return Wall->GetTransform().TransformPosition(FVector(1.0, WallLocation.X, WallLocation.Y));
+		}
+
+		UWorld* World = nullptr;
+		APPortalWall* Wall = nullptr;
+		APPortal* LeftPortal = nullptr;
+		APPortal* RightPortal = nullptr;
+	};
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalSpaceConversionTest, "Portal.Helpers.PortalSpaceConversion", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalSpaceConversionTest::RunTest(const FString& Parameters)
+{
+	const PortalTests::FPortalTestWorld TestWorld;
+	APPortal* LeftPortal = TestWorld.LeftPortal;
+	APPortal* RightPortal = TestWorld.RightPortal;
+
+	// The center of a portal comes out at the center of the other one
+	const FVector LeftCenter = LeftPortal->GetPortalMesh()->GetComponentLocation();
+	const FVector RightCenter = RightPortal->GetPortalMesh()->GetComponentLocation();
+	TestTrue(TEXT("Portal center maps to the linked portal center"), UPPortalHelper::ConvertLocationToPortalSpace(LeftCenter, LeftPortal, RightPortal).Equals(RightCenter, 0.01));
+
+	// Going into a portal is coming out of the other one
+	const FVector IntoLeft = -LeftPortal->GetPortalMesh()->GetForwardVector();
+	const FVector OutOfRight = RightPortal->GetPortalMesh()->GetForwardVector();
+	TestTrue(TEXT("Direction into the portal maps to the linked portal forward"), UPPortalHelper::ConvertDirectionToPortalSpace(IntoLeft, LeftPortal, RightPortal).Equals(OutOfRight, 0.001));
+
+	// Converting back gives the original transform
+	const FVector Location(150.0, -300.0, 40.0);
+	const FVector LocationRoundTrip = UPPortalHelper::ConvertLocationToPortalSpace(UPPortalHelper::ConvertLocationToPortalSpace(Location, LeftPortal, RightPortal), RightPortal, LeftPortal);
+	TestTrue(TEXT("Location round trip"), LocationRoundTrip.Equals(Location, 0.01));
+
+	const FRotator Rotation(10.0, 45.0, 0.0);
+	const FRotator RotationRoundTrip = UPPortalHelper::ConvertRotationToPortalSpace(UPPortalHelper::ConvertRotationToPortalSpace(Rotation, LeftPortal, RightPortal), RightPortal, LeftPortal);
+	TestTrue(TEXT("Rotation round trip"), FQuat(RotationRoundTrip).Equals(FQuat(Rotation), 0.0001));
+
+	// The batch conversion matches the single ones
+	TArray<FVector> Locations = { Location, LeftCenter, FVector(-20.0, 80.0, -35.0) };
+	TArray<FQuat> Rotations = { FQuat(Rotation), FQuat::Identity };
+	TArray<FVector> ExpectedLocations;
+	for (const FVector& Each : Locations)
+		ExpectedLocations.Add(UPPortalHelper::ConvertLocationToPortalSpace(Each, LeftPortal, RightPortal));
+
+	TArray<FQuat> ExpectedRotations;
+	for (const FQuat& Each : Rotations)
+		ExpectedRotations.Add(FQuat(UPPortalHelper::ConvertRotationToPortalSpace(Each.Rotator(), LeftPortal, RightPortal)));
+
+	UPPortalHelper::ConvertTransformsToPortalSpace(Locations, Rotations, LeftPortal, RightPortal);
+	for (int32 i = 0; i < Locations.Num(); i++)
+		TestTrue(FString::Printf(TEXT("Batch location %d"), i), Locations[i].Equals(ExpectedLocations[i], 0.01));
+
+	for (int32 i = 0; i < Rotations.Num(); i++)
+		TestTrue(FString::Printf(TEXT("Batch rotation %d"), i), Rotations[i].Equals(ExpectedRotations[i], 0.0001));
+
+	// Nothing to convert to without a target portal
+	TestEqual(TEXT("Location without a target portal"), UPPortalHelper::ConvertLocationToPortalSpace(Location, LeftPortal, nullptr), FVector::ZeroVector);
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalPlacementTest, "Portal.Wall.FindPortalPlacement", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalPlacementTest::RunTest(const FString& Parameters)
+{
+	const PortalTests::FPortalTestWorld TestWorld;
+	APPortalWall* Wall = TestWorld.Wall;
+	const FVector2D& Extents = PortalTests::PortalExtents;
+	FVector2D Location;
+
+	// Nothing in the way, the portal stays where it is wanted
+	TestTrue(TEXT("Free spot is found"), Wall->FindPortalPlacement(FVector2D::ZeroVector, Extents, true, Location));
+	TestTrue(TEXT("Free spot is kept"), Location.Equals(FVector2D::ZeroVector, 0.01));
+
+	// Past the wall edge, the portal is pushed back inside
+	TestTrue(TEXT("Spot past the edge is found"), Wall->FindPortalPlacement(FVector2D(2000.0, 0.0), Extents, true, Location));
+	TestTrue(TEXT("Portal is kept inside the wall"), Location.Equals(FVector2D(940.0, 0.0), 0.01));
+
+	// On the other portal, the nearest free spot is right beside it, the other side being a hole
+	TestTrue(TEXT("Spot on the other portal is found"), Wall->FindPortalPlacement(FVector2D(250.0, 0.0), Extents, true, Location));
+	TestTrue(TEXT("Portal is moved beside the other portal"), Location.Equals(FVector2D(129.9, 0.0), 0.01));
+	TestTrue(TEXT("Moved portal is clear of the other portal"), UPPortalHelper::IsPortalPlacementClear(TestWorld.RightPortal, Wall, TestWorld.ToWorld(Location), Extents));
+
+	// The portal being moved doesn't block itself
+	TestTrue(TEXT("Spot on the moved portal is found"), Wall->FindPortalPlacement(FVector2D(250.0, 0.0), Extents, false, Location));
+	TestTrue(TEXT("Portal stays on its own spot"), Location.Equals(FVector2D(250.0, 0.0), 0.01));
+
+	TestFalse(TEXT("Portal wider than the wall fits nowhere"), Wall->FindPortalPlacement(FVector2D::ZeroVector, FVector2D(1100.0, 100.0), true, Location));
+
+	// More holes than the placement looks at, the other portal is still avoided
+	TArray<FBox2D> Holes;
+	for (int32 i = 0; i < 10; i++)
+		Holes.Add(FBox2D(FVector2D(-1000.0 + i * 10.0, -500.0), FVector2D(-995.0 + i * 10.0, -495.0)));
+
+	Wall->SetHoles(Holes);
+	TestTrue(TEXT("Spot on the other portal is found with many holes"), Wall->FindPortalPlacement(FVector2D(250.0, 0.0), Extents, true, Location));
+	TestEqual(TEXT("Portal is moved to the nearest side of the other portal"), FVector2D::Distance(Location, FVector2D(250.0, 0.0)), 120.1, 0.01);
+	TestTrue(TEXT("Moved portal is clear of the other portal with many holes"), UPPortalHelper::IsPortalPlacementClear(TestWorld.RightPortal, Wall, TestWorld.ToWorld(Location), Extents));
+
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalTryGetPortalPosTest, "Portal.Wall.TryGetPortalPos", EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalTryGetPortalPosTest::RunTest(const FString& Parameters)
+{
+	const PortalTests::FPortalTestWorld TestWorld;
+	const APPortalWall* Wall = TestWorld.Wall;
+
+	// The ghost border never begins play, give it the hull of a 120 by 200 centimeters border instead of reading a mesh
+	APGhostPortalBorder* GhostBorder = TestWorld.World->SpawnActor<APGhostPortalBorder>(FVector(1.0, 0.0, 0.0), FRotator::ZeroRotator);
+	GhostBorder->SetHullVertices({ FVector(-100.0, -60.0, 0.0), FVector(100.0, -60.0, 0.0), FVector(100.0, 60.0, 0.0), FVector(-100.0, 60.0, 0.0) });
+	const FVector2D BorderExtents = GhostBorder->GetHalfExtentsOnWall(Wall->GetTransform());
+
+	FVector PortalLocation;
+	FVector2D PortalExtents;
+
+	// Nothing in the way, the portal stays where it was shot
+	const FVector FreeShot = TestWorld.ToWorld(FVector2D::ZeroVector);
+	TestTrue(TEXT("Free shot places a portal"), Wall->TryGetPortalPos(FreeShot, GhostBorder, true, PortalLocation, PortalExtents));
+	TestTrue(TEXT("Portal extents are the ghost border ones"), PortalExtents.Equals(BorderExtents, 0.01));
+	TestTrue(TEXT("Free shot portal stays where it was shot"), PortalLocation.Equals(FreeShot, 0.01));
+
+	// A shot on the other portal is moved aside, on the wall and clear of it
+	TestTrue(TEXT("Shot on the other portal places a portal"), Wall->TryGetPortalPos(TestWorld.ToWorld(FVector2D(250.0, 0.0)), GhostBorder, true, PortalLocation, PortalExtents));
+	TestEqual(TEXT("Moved portal stays on the wall plane"), Wall->GetTransform().InverseTransformPosition(PortalLocation).X, 1.0, 0.01);
+	TestTrue(TEXT("Moved portal is clear of the other portal"), UPPortalHelper::IsPortalPlacementClear(TestWorld.RightPortal, Wall, PortalLocation, PortalExtents));
+
+	return true;
+}
+
+#endif